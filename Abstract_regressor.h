@@ -2,14 +2,27 @@
 #define TREE_ABSTRACT_REGRESSOR_H
 
 #include <vector>
+#include <memory>
 #include "Table.h"
+#include "Matrix.h"
 
 class Abstract_regressor {
 public:
+    virtual ~Abstract_regressor() = default;
+
+    /// Function that creates an untrained regressor with the same parameters
+    virtual std::unique_ptr<Abstract_regressor> clone() const = 0;
+
     /// Model training function
     virtual void fit(
-        const Table &x,                           ///< Feature set
-        const std::vector<std::vector<double>> &y ///< Feature-related observations
+        const Table &x, ///< Feature set
+        const Matrix &y ///< Feature-related observations (one row per feature set)
+    ) = 0;
+
+    /// Function that updates the trained model with one new observation without retraining it
+    virtual void partial_fit(
+        const std::vector<double> &row, ///< One feature set
+        const std::vector<double> &y    ///< Feature-related observation
     ) = 0;
 
     /// Prediction function for one set of features
@@ -18,7 +31,7 @@ public:
     ) const = 0;
 
     /// Prediction function for multiple feature sets
-    virtual std::vector<std::vector<double>> predict(
+    virtual Matrix predict(
         const Table &values ///< Multiple feature sets
     ) const = 0;
 };
@@ -0,0 +1,70 @@
+#ifndef TREE_ALIGNED_ALLOCATOR_H
+#define TREE_ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+/// Standard allocator returning memory aligned to the cache line boundary
+template <typename T, size_t Alignment = 64>
+class Aligned_allocator {
+public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef Aligned_allocator<U, Alignment> other;
+    };
+
+    Aligned_allocator() = default;
+
+    template <typename U>
+    Aligned_allocator(const Aligned_allocator<U, Alignment> &) {}
+
+    /// Function that allocates uninitialized aligned memory for n objects
+    T* allocate(size_t n) {
+        if (!n) {
+            return nullptr;
+        }
+
+        void *ptr = nullptr;
+#if defined(_WIN32)
+        ptr = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+        if (posix_memalign(&ptr, Alignment, n * sizeof(T))) {
+            ptr = nullptr;
+        }
+#endif
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+
+        return static_cast<T*>(ptr);
+    }
+
+    /// Function that releases memory obtained from allocate
+    void deallocate(T *ptr, size_t) {
+#if defined(_WIN32)
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const Aligned_allocator<T, Alignment> &, const Aligned_allocator<U, Alignment> &) {
+    return true;
+}
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const Aligned_allocator<T, Alignment> &, const Aligned_allocator<U, Alignment> &) {
+    return false;
+}
+
+
+#endif //TREE_ALIGNED_ALLOCATOR_H
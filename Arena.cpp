@@ -0,0 +1,59 @@
+#include "Arena.h"
+
+#include <algorithm>
+
+std::atomic<uint64_t> Arena::next_id(1);
+
+Arena::Arena(size_t block_size) : block_size(block_size), id(next_id.fetch_add(1)) {}
+
+Arena::~Arena() {
+    for (auto part = this->parts.rbegin(); part != this->parts.rend(); ++part) {
+        for (auto it = (*part)->objects.rbegin(); it != (*part)->objects.rend(); ++it) {
+            it->second(it->first);
+        }
+    }
+}
+
+void *Arena::allocate(size_t bytes, size_t alignment) {
+    return this->allocate(this->get_part(), bytes, alignment);
+}
+
+Arena::Part &Arena::get_part() {
+    // The last arena used by the thread and the part of the thread in it
+    static thread_local uint64_t cached_id = 0;
+    static thread_local Part *cached = nullptr;
+
+    if (cached_id == this->id) {
+        return *cached;
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    const std::thread::id thread = std::this_thread::get_id();
+    auto it = std::find_if(this->parts.begin(), this->parts.end(),
+                           [&thread](const std::unique_ptr<Part> &part){return part->owner == thread;});
+
+    if (it == this->parts.end()) {
+        this->parts.emplace_back(new Part());
+        this->parts.back()->owner = thread;
+        it = this->parts.end() - 1;
+    }
+
+    cached_id = this->id;
+    cached = it->get();
+
+    return *cached;
+}
+
+void *Arena::allocate(Part &part, size_t bytes, size_t alignment) const {
+    size_t begin = (part.used + alignment - 1) / alignment * alignment;
+
+    if (part.blocks.empty() || begin + bytes > part.capacity) {
+        // Blocks come from operator new[] and are aligned for any fundamental type
+        part.capacity = std::max(this->block_size, bytes);
+        part.blocks.emplace_back(new char[part.capacity]);
+        begin = 0;
+    }
+
+    part.used = begin + bytes;
+    return part.blocks.back().get() + begin;
+}
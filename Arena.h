@@ -0,0 +1,136 @@
+#ifndef TREE_ARENA_H
+#define TREE_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// Memory arena of one tree
+///
+/// Objects are carved out of large blocks and are never released one by one: the arena destroys all objects
+/// it created (thread by thread, latest first) and frees its blocks together. Allocation is thread-safe: every
+/// thread carves from blocks of its own, the arena is locked only when a thread switches to it from another arena.
+class Arena {
+public:
+    explicit Arena(
+        size_t block_size = 1 << 16 ///< Size of one memory block in bytes
+    );
+
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena& operator=(const Arena &) = delete;
+
+    /// Function that allocates uninitialized memory released together with the arena
+    void* allocate(
+        size_t bytes,    ///< Size of the memory
+        size_t alignment ///< Alignment of the memory (at most alignof(std::max_align_t))
+    );
+
+    /// Function that creates an object destroyed together with the arena
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        Part &part = this->get_part();
+        T *ans = new (this->allocate(part, sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        part.objects.emplace_back(ans, [](void *ptr){static_cast<T*>(ptr)->~T();});
+
+        return ans;
+    }
+
+private:
+    /// Memory blocks and created objects of one thread
+    struct Part {
+        std::thread::id owner;                                  ///< Thread allocating from the part
+        size_t used = 0;                                        ///< Bytes used in the last block
+        size_t capacity = 0;                                    ///< Size of the last block in bytes
+        std::vector<std::unique_ptr<char[]>> blocks;            ///< Memory blocks
+        std::vector<std::pair<void*, void (*)(void*)>> objects; ///< Created objects and their destructors
+    };
+
+    /// Function that returns the part of the calling thread, creating it on first use
+    Part& get_part();
+
+    /// Function that allocates uninitialized memory from the blocks of a part
+    void* allocate(
+        Part &part,      ///< Part of the calling thread
+        size_t bytes,    ///< Size of the memory
+        size_t alignment ///< Alignment of the memory
+    ) const;
+
+private:
+    static std::atomic<uint64_t> next_id; ///< Number of the next created arena
+
+    std::mutex mutex;                         ///< Guard of the parts list
+    size_t block_size;                        ///< Size of a regular memory block in bytes
+    uint64_t id;                              ///< Unique number of the arena (addresses of destroyed arenas are reused)
+    std::vector<std::unique_ptr<Part>> parts; ///< Parts of all threads that used the arena
+};
+
+/// Standard allocator taking memory from an arena (or from the heap if there is no arena)
+///
+/// Memory taken from an arena is given back only when the arena is destroyed.
+template <typename T>
+class Arena_allocator {
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind {
+        typedef Arena_allocator<U> other;
+    };
+
+    Arena_allocator() = default;
+
+    explicit Arena_allocator(
+        Arena *arena ///< Source of memory (nullptr - heap)
+    ) : arena(arena) {}
+
+    template <typename U>
+    Arena_allocator(const Arena_allocator<U> &other) : arena(other.get_arena()) {}
+
+    /// Function that allocates uninitialized memory for n objects
+    T* allocate(size_t n) {
+        if (this->arena) {
+            return static_cast<T*>(this->arena->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    /// Function that releases memory obtained from allocate (a no-op for arena memory)
+    void deallocate(T *ptr, size_t) {
+        if (!this->arena) {
+            ::operator delete(ptr);
+        }
+    }
+
+    /// Function that returns the source of memory
+    Arena* get_arena() const {
+        return this->arena;
+    }
+
+private:
+    Arena *arena = nullptr; ///< Source of memory (nullptr - heap)
+};
+
+template <typename T, typename U>
+bool operator==(const Arena_allocator<T> &a, const Arena_allocator<U> &b) {
+    return a.get_arena() == b.get_arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const Arena_allocator<T> &a, const Arena_allocator<U> &b) {
+    return a.get_arena() != b.get_arena();
+}
+
+
+#endif //TREE_ARENA_H
@@ -0,0 +1,68 @@
+#ifndef TREE_ARRAY_VIEW_H
+#define TREE_ARRAY_VIEW_H
+
+#include <cstddef>
+#include <vector>
+
+/// Non-owning view of a sequence of values placed in memory with a constant stride
+///
+/// With a non-zero period the stride pattern restarts every period elements, shifted by a constant distance
+/// (this describes a row of a lagged table).
+class Array_view {
+public:
+    Array_view() = default;
+
+    Array_view(
+        const double *data, ///< Pointer to the first element
+        size_t size,        ///< Number of elements
+        size_t stride = 1,  ///< Distance between neighbouring elements
+        size_t period = 0,  ///< Number of elements after which the stride pattern restarts (0 - never)
+        size_t shift = 0    ///< Distance between the first elements of neighbouring periods
+    ) : ptr(data), count(size), step(stride), period(period), shift(shift) {}
+
+    /// Element access function (without bounds checking)
+    const double& operator[](size_t i) const {
+        if (this->period) {
+            return this->ptr[(i % this->period) * this->step + (i / this->period) * this->shift];
+        }
+
+        return this->ptr[i * this->step];
+    }
+
+    /// Function that returns the number of elements
+    size_t size() const {
+        return this->count;
+    }
+
+    /// Function that returns the distance between neighbouring elements (within a period)
+    size_t stride() const {
+        return this->step;
+    }
+
+    /// Function that returns a pointer to the first element
+    const double* data() const {
+        return this->ptr;
+    }
+
+    /// Function that copies the viewed values into a new array
+    std::vector<double> to_vector() const {
+        std::vector<double> ans;
+        ans.reserve(this->count);
+
+        for (size_t i = 0; i < this->count; ++i) {
+            ans.push_back((*this)[i]);
+        }
+
+        return ans;
+    }
+
+private:
+    const double *ptr = nullptr; ///< Pointer to the first element
+    size_t count = 0;            ///< Number of elements
+    size_t step = 1;             ///< Distance between neighbouring elements
+    size_t period = 0;           ///< Number of elements after which the stride pattern restarts (0 - never)
+    size_t shift = 0;            ///< Distance between the first elements of neighbouring periods
+};
+
+
+#endif //TREE_ARRAY_VIEW_H
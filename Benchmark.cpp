@@ -0,0 +1,494 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include "Regression_tree.h"
+#include "Random_forest_regressor.h"
+#include "Split_search.h"
+#include "Histogram.h"
+#include "Random_generator.h"
+#include "Tools.h"
+
+#if defined(__GNUC__)
+#define TREE_BENCHMARK_NOINLINE __attribute__((noinline))
+#else
+#define TREE_BENCHMARK_NOINLINE
+#endif
+
+namespace {
+    /// Number of operator new calls since the start of the program. Aligned storage (Table columns and binned
+    /// feature codes) is taken by Aligned_allocator straight from posix_memalign and is not counted.
+    std::atomic<size_t> allocations(0);
+
+    /// Function that counts one heap allocation, kept out of line so that the compiler sees the replaced
+    /// operators call the same pair of functions rather than operator new paired with free
+    TREE_BENCHMARK_NOINLINE void *counted_allocate(size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(size ? size : 1);
+    }
+
+    /// Function that releases memory obtained from counted_allocate
+    TREE_BENCHMARK_NOINLINE void counted_release(void *ptr) {
+        std::free(ptr);
+    }
+}
+
+void* operator new(size_t size) {
+    if (void *ptr = counted_allocate(size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    counted_release(ptr);
+}
+
+namespace {
+
+/// Noise added to the synthetic observations
+enum class Noise {
+    none,     ///< Noiseless observations
+    gaussian, ///< Normal noise with standard deviation sigma
+    uniform,  ///< Uniform noise with standard deviation sigma
+    cauchy    ///< Heavy-tailed Cauchy noise with scale sigma
+};
+
+/// Benchmark parameters
+struct Config {
+    size_t rows = 100000;          ///< Number of synthetic rows
+    size_t features = 16;          ///< Number of synthetic features
+    size_t outputs = 1;            ///< Number of synthetic outputs
+    Noise noise = Noise::gaussian; ///< Noise model of the synthetic observations
+    double sigma = 0.1;            ///< Noise scale
+    size_t trees = 100;            ///< Number of trees in forest benchmarks
+    size_t max_depth = 8;          ///< Maximum tree depth
+    size_t min_samples_split = 20; ///< Minimum sample size that can be at the tree node
+    double min_time = 0.5;         ///< Minimum measured time of one benchmark in seconds
+    uint64_t seed = 1;             ///< Seed of the synthetic data and of the forests
+    std::string data_dir = "..";   ///< Directory with the bundled CSV files
+    std::string filter;            ///< Only benchmarks whose name contains this string are run
+};
+
+/// Synthetic regression problem: y_k = sum_j w_kj * x_j + sin(2 pi x_k) + noise, x uniform in [0, 1)
+struct Dataset {
+    Table x;  ///< Feature set
+    Matrix y; ///< Feature-related observations
+};
+
+Dataset make_dataset(const Config &config) {
+    const double pi = std::acos(-1.0);
+    Random_generator gen(config.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, config.sigma);
+    std::uniform_real_distribution<double> uniform(-config.sigma * std::sqrt(3.0), config.sigma * std::sqrt(3.0));
+    std::cauchy_distribution<double> cauchy(0.0, config.sigma);
+
+    std::vector<double> weights(config.outputs * config.features);
+    for (auto &weight : weights) {
+        weight = unit(gen) * 2 - 1;
+    }
+
+    Dataset ans;
+    std::vector<double> values(config.rows * config.features);
+    ans.y = Matrix(config.rows, config.outputs);
+
+    for (size_t i = 0; i < config.rows; ++i) {
+        double *row = values.data() + i * config.features;
+        for (size_t j = 0; j < config.features; ++j) {
+            row[j] = unit(gen);
+        }
+
+        for (size_t k = 0; k < config.outputs; ++k) {
+            double value = std::sin(2 * pi * row[k % config.features]);
+            for (size_t j = 0; j < config.features; ++j) {
+                value += weights[k * config.features + j] * row[j];
+            }
+
+            switch (config.noise) {
+                case Noise::gaussian: value += normal(gen); break;
+                case Noise::uniform: value += uniform(gen); break;
+                case Noise::cauchy: value += cauchy(gen); break;
+                case Noise::none: break;
+            }
+
+            ans.y.at(i, k) = value;
+        }
+    }
+
+    ans.x.load_from_array(values.data(), config.rows, config.features);
+    return ans;
+}
+
+/// Function that writes a table to a CSV file with a header
+void write_csv(const Table &x, const std::string &file_name) {
+    std::ofstream out(file_name);
+    out << std::setprecision(17);
+
+    for (size_t j = 0; j < x.get_columns_count(); ++j) {
+        out << (j ? "," : "") << "x" << j;
+    }
+    out << '\n';
+
+    for (size_t i = 0; i < x.get_rows_count(); ++i) {
+        for (size_t j = 0; j < x.get_columns_count(); ++j) {
+            out << (j ? "," : "") << x.at(i, j);
+        }
+        out << '\n';
+    }
+}
+
+/// Measurement of one benchmark
+struct Result {
+    size_t iterations = 0;  ///< Number of measured iterations
+    double seconds = 0;     ///< Best time of one iteration
+    double allocations = 0; ///< Mean number of operator new calls per iteration (aligned storage excluded)
+    size_t nodes = 0;       ///< Number of nodes built by one iteration (0 - not applicable)
+};
+
+/// Benchmark runner printing one line per benchmark
+class Runner {
+public:
+    explicit Runner(const Config &config) : config(config) {
+        std::cout << std::left << std::setw(48) << "benchmark" << std::right
+                  << std::setw(8) << "iters" << std::setw(12) << "ms/iter" << std::setw(14) << "rows/s"
+                  << std::setw(14) << "nodes/s" << std::setw(14) << "allocs/iter" << '\n';
+    }
+
+    /// Function that repeats a benchmark body for at least min_time seconds,
+    /// the body processes rows rows and returns the number of nodes it built
+    void run(const std::string &name, size_t rows, const std::function<size_t()> &body) {
+        if (name.find(this->config.filter) == std::string::npos) {
+            return;
+        }
+
+        Result result;
+        double total = 0;
+        result.seconds = std::numeric_limits<double>::max();
+        const size_t allocations_before = allocations.load();
+
+        while (total < this->config.min_time || result.iterations == 0) {
+            const auto start = std::chrono::steady_clock::now();
+            result.nodes = body();
+            const auto stop = std::chrono::steady_clock::now();
+
+            const double seconds = std::chrono::duration<double>(stop - start).count();
+            result.seconds = std::min(result.seconds, seconds);
+            total += seconds;
+            ++result.iterations;
+        }
+
+        result.allocations = static_cast<double>(allocations.load() - allocations_before) /
+                             static_cast<double>(result.iterations);
+
+        std::cout << std::left << std::setw(48) << name << std::right << std::fixed
+                  << std::setw(8) << result.iterations
+                  << std::setw(12) << std::setprecision(3) << result.seconds * 1e3
+                  << std::setw(14) << std::setprecision(0) << static_cast<double>(rows) / result.seconds
+                  << std::setw(14) << (result.nodes ? static_cast<double>(result.nodes) / result.seconds : 0.0)
+                  << std::setw(14) << std::setprecision(1) << result.allocations << std::endl;
+    }
+
+private:
+    const Config &config; ///< Benchmark parameters
+};
+
+/// Function that splits a supervised table into features and observations
+Dataset split_supervised(const Table &data, size_t n_out) {
+    Dataset ans;
+    const size_t features = data.get_columns_count() - n_out;
+    ans.x = data.prefix(data.get_rows_count(), features);
+    ans.y = Matrix(data.get_rows_count(), n_out);
+
+    for (size_t i = 0; i < data.get_rows_count(); ++i) {
+        double *row = ans.y.row_data(i);
+        for (size_t j = 0; j < n_out; ++j) {
+            row[j] = data.at(i, features + j);
+        }
+    }
+
+    return ans;
+}
+
+Config parse_arguments(int argc, char **argv) {
+    Config config;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string key = argv[i];
+        if (key == "--help") {
+            throw std::invalid_argument("");
+        }
+
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value of " + key);
+        }
+        const std::string value = argv[++i];
+
+        if (key == "--rows") config.rows = std::stoul(value);
+        else if (key == "--features") config.features = std::stoul(value);
+        else if (key == "--outputs") config.outputs = std::stoul(value);
+        else if (key == "--sigma") config.sigma = std::stod(value);
+        else if (key == "--trees") config.trees = std::stoul(value);
+        else if (key == "--depth") config.max_depth = std::stoul(value);
+        else if (key == "--min-samples-split") config.min_samples_split = std::stoul(value);
+        else if (key == "--min-time") config.min_time = std::stod(value);
+        else if (key == "--seed") config.seed = std::stoull(value);
+        else if (key == "--data-dir") config.data_dir = value;
+        else if (key == "--filter") config.filter = value;
+        else if (key == "--noise") {
+            if (value == "none") config.noise = Noise::none;
+            else if (value == "gaussian") config.noise = Noise::gaussian;
+            else if (value == "uniform") config.noise = Noise::uniform;
+            else if (value == "cauchy") config.noise = Noise::cauchy;
+            else throw std::invalid_argument("Unknown noise model " + value);
+        }
+        else {
+            throw std::invalid_argument("Unknown option " + key);
+        }
+    }
+
+    if (!config.rows || !config.features || !config.outputs) {
+        throw std::invalid_argument("rows, features and outputs must be positive");
+    }
+
+    return config;
+}
+
+const char *usage =
+    "Usage: Tree_benchmark [--rows N] [--features N] [--outputs N] [--noise none|gaussian|uniform|cauchy]\n"
+    "                      [--sigma S] [--trees N] [--depth N] [--min-samples-split N] [--min-time SECONDS]\n"
+    "                      [--seed N] [--data-dir DIR] [--filter SUBSTRING]\n";
+
+const char *method_name(Split_method method) {
+    switch (method) {
+        case Split_method::exact: return "exact";
+        case Split_method::presorted: return "presorted";
+        case Split_method::histogram: return "histogram";
+    }
+    return "";
+}
+
+void run_benchmarks(const Config &config) {
+    Runner runner(config);
+    volatile double sink = 0; // keeps results of the measured code alive
+
+    // Loading: bundled series and a synthetic table written to a temporary CSV file
+    for (const std::string name : {"daily-min-temperatures", "daily-total-female-births"}) {
+        const std::string file_name = config.data_dir + "/" + name + ".csv";
+        if (!std::ifstream(file_name)) {
+            std::cerr << "Skipping " << file_name << " (not found, see --data-dir)\n";
+            continue;
+        }
+
+        Table series;
+        series.load_from_file(file_name, {"Date"});
+        runner.run("load_from_file/" + name, series.get_rows_count(), [&]() {
+            Table t;
+            t.load_from_file(file_name, {"Date"});
+            sink = sink + static_cast<double>(t.get_rows_count());
+            return size_t(0);
+        });
+
+        runner.run("series_to_supervised/" + name, series.get_rows_count(), [&]() {
+            Table t = series_to_supervised(series, 7, 2);
+            sink = sink + t.at(0, 0);
+            return size_t(0);
+        });
+
+        const Dataset supervised = split_supervised(series_to_supervised(series, 7, 1), 1);
+        runner.run("forest_fit/" + name, supervised.y.get_rows_count(), [&]() {
+            Random_forest_regressor forest(config.trees, 0.75, 1.0, 3, 5, Split_method::exact, false, config.seed);
+            forest.fit(supervised.x, supervised.y);
+            return forest.get_compiled().get_nodes_count();
+        });
+    }
+
+    const Dataset data = make_dataset(config);
+    const Table &x = data.x;
+    const auto &y = data.y;
+    const size_t rows = config.rows;
+
+    const std::string csv_name = "Tree_benchmark_synthetic.csv";
+    write_csv(x, csv_name);
+    runner.run("load_from_file/synthetic", rows, [&]() {
+        Table t;
+        t.load_from_file(csv_name);
+        sink = sink + static_cast<double>(t.get_rows_count());
+        return size_t(0);
+    });
+    std::remove(csv_name.c_str());
+
+    // Root node split search over all features, the same steps as get_best_split of the trees
+    runner.run("best_split/exact", rows, [&]() {
+        std::vector<int> order(rows);
+        std::iota(order.begin(), order.end(), 0);
+        const Target_sums sums = get_target_sums(y, order.data(), rows);
+        long double mse_base = get_rows_mse(y, order.data(), rows, get_rows_mean(y, order.data(), rows),
+                                            static_cast<double>(rows * config.outputs));
+        std::pair<int, double> ans(-1, 0.0);
+        Split_candidates candidates;
+
+        for (size_t feature = 0; feature < config.features; ++feature) {
+            const Array_view arr = x.column(feature);
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&arr](int a, int b){return arr[a] < arr[b];});
+            scan_feature<Moving_average_thresholds<2>>(arr, order.data(), rows, y, sums, static_cast<int>(feature),
+                                                      mse_base, ans, candidates);
+        }
+
+        sink = sink + ans.second;
+        return size_t(0);
+    });
+
+    Presorted_features presorted;
+    presorted.build(x);
+    runner.run("best_split/presorted", rows, [&]() {
+        const Target_sums sums = get_target_sums(y, presorted.order(0, 0), rows);
+        long double mse_base = std::numeric_limits<long double>::max();
+        std::pair<int, double> ans(-1, 0.0);
+        Split_candidates candidates;
+
+        for (size_t feature = 0; feature < config.features; ++feature) {
+            scan_feature<Moving_average_thresholds<2>>(x.column(feature), presorted.order(feature, 0), rows, y, sums,
+                                                      static_cast<int>(feature), mse_base, ans, candidates);
+        }
+
+        sink = sink + ans.second;
+        return size_t(0);
+    });
+
+    Binned_features bins;
+    bins.build(x);
+    runner.run("best_split/histogram", rows, [&]() {
+        std::vector<int> order(rows);
+        std::iota(order.begin(), order.end(), 0);
+        Histogram hist(bins, config.outputs);
+        hist.build(bins, y, order.data(), rows);
+        const Target_sums sums = get_target_sums(y, order.data(), rows);
+        long double mse_base = std::numeric_limits<long double>::max();
+        std::pair<int, int> ans(-1, 0);
+
+        for (size_t feature = 0; feature < config.features; ++feature) {
+            hist.scan_feature(feature, rows, sums, mse_base, ans);
+        }
+
+        sink = sink + ans.second;
+        return size_t(0);
+    });
+
+    runner.run("presort", rows, [&]() {
+        Presorted_features features;
+        features.build(x);
+        sink = sink + *features.order(0, 0);
+        return size_t(0);
+    });
+
+    runner.run("binning", rows, [&]() {
+        Binned_features features;
+        features.build(x);
+        sink = sink + features.get_bins_count(0);
+        return size_t(0);
+    });
+
+    // Partition of the node rows by the split threshold, the same step as split of the trees
+    std::vector<int> shuffled(rows);
+    std::iota(shuffled.begin(), shuffled.end(), 0);
+    runner.run("split", rows, [&]() {
+        std::vector<int> order(shuffled);
+        const Array_view arr = x.column(0);
+        const auto mid = std::partition(order.begin(), order.end(), [&arr](int row){return arr[row] <= 0.5;});
+        sink = sink + static_cast<double>(mid - order.begin());
+        return size_t(0);
+    });
+
+    for (const auto method : {Split_method::exact, Split_method::presorted, Split_method::histogram}) {
+        const std::string suffix = std::string("/") + method_name(method);
+
+        Regression_tree tree(config.min_samples_split, config.max_depth, method);
+        runner.run("tree_fit" + suffix, rows, [&]() {
+            Regression_tree fitted(config.min_samples_split, config.max_depth, method);
+            fitted.fit(x, y);
+            return fitted.compile().get_nodes_count();
+        });
+
+        tree.fit(x, y);
+        runner.run("tree_predict" + suffix, rows, [&]() {
+            sink = sink + tree.predict(x).at(0, 0);
+            return size_t(0);
+        });
+
+        Random_forest_regressor forest(config.trees, 0.75, 1.0, config.min_samples_split, config.max_depth, method,
+                                       false, config.seed);
+        runner.run("forest_fit" + suffix, rows, [&]() {
+            forest.fit(x, y);
+            return forest.get_compiled().get_nodes_count();
+        });
+
+        runner.run("forest_predict" + suffix, rows, [&]() {
+            sink = sink + forest.predict(x).at(0, 0);
+            return size_t(0);
+        });
+
+        runner.run("forest_predict_row" + suffix, rows, [&]() {
+            std::vector<double> row(config.features);
+            for (size_t i = 0; i < rows; ++i) {
+                for (size_t j = 0; j < config.features; ++j) {
+                    row[j] = x.at(i, j);
+                }
+                sink = sink + forest.predict(row).front();
+            }
+            return size_t(0);
+        });
+
+    }
+
+    runner.run("tree_fit/histogram_level_wise", rows, [&]() {
+        Regression_tree fitted(config.min_samples_split, config.max_depth, Split_method::histogram,
+                               Growth_order::level_wise);
+        fitted.fit(x, y);
+        return fitted.compile().get_nodes_count();
+    });
+
+    Random_forest_regressor level_wise(config.trees, 0.75, 1.0, config.min_samples_split, config.max_depth,
+                                       Split_method::histogram, false, config.seed, 0, Growth_order::level_wise);
+    runner.run("forest_fit/histogram_level_wise", rows, [&]() {
+        level_wise.fit(x, y);
+        return level_wise.get_compiled().get_nodes_count();
+    });
+}
+
+}
+
+int main(int argc, char **argv) {
+    Config config;
+
+    try {
+        config = parse_arguments(argc, argv);
+    }
+    catch (const std::exception &e) {
+        std::cerr << e.what() << (*e.what() ? "\n" : "") << usage;
+        return 1;
+    }
+
+    std::cout << "rows " << config.rows << ", features " << config.features << ", outputs " << config.outputs
+              << ", trees " << config.trees << ", max depth " << config.max_depth << '\n';
+
+    run_benchmarks(config);
+
+    return 0;
+}
@@ -0,0 +1,559 @@
+#include "Compiled_forest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define TREE_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define TREE_X86_KERNELS 0
+#endif
+
+namespace {
+    constexpr size_t block_size = 8; ///< Number of rows traversing a tree in lockstep
+
+    /// Node arrays of a compiled forest
+    struct Node_arrays {
+        const int32_t *feature;
+        const double *threshold;
+        const uint32_t *child;
+    };
+
+    /// Function that moves a block of rows from the root to the leaves, stores the reached leaf nodes
+    typedef void (*Block_kernel)(const Node_arrays &nodes, uint32_t root, const double *const *columns,
+                                 size_t first_row, size_t count, uint32_t *leaves);
+
+    void traverse_block_scalar(const Node_arrays &nodes, uint32_t root, const double *const *columns,
+                               size_t first_row, size_t count, uint32_t *leaves)
+    {
+        std::fill(leaves, leaves + count, root);
+        bool active = true;
+
+        while (active) {
+            active = false;
+            for (size_t i = 0; i < count; ++i) {
+                const int32_t feature = nodes.feature[leaves[i]];
+                if (feature >= 0) {
+                    leaves[i] = nodes.child[leaves[i]] +
+                                (columns[feature][first_row + i] > nodes.threshold[leaves[i]]);
+                    active = true;
+                }
+            }
+        }
+    }
+
+#if TREE_X86_KERNELS
+    __attribute__((target("avx2")))
+    void traverse_block_avx2(const Node_arrays &nodes, uint32_t root, const double *const *columns,
+                             size_t first_row, size_t, uint32_t *leaves)
+    {
+        const auto *feature = reinterpret_cast<const int *>(nodes.feature);
+        const auto *child = reinterpret_cast<const int *>(nodes.child);
+        const auto *column = reinterpret_cast<const long long *>(columns);
+        const __m256i lanes_to_half = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+        const __m128i minus_one = _mm_set1_epi32(-1);
+        const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+        __m128i node[2] = {_mm_set1_epi32(static_cast<int>(root)), _mm_set1_epi32(static_cast<int>(root))};
+        const __m256i row_bytes[2] = {
+            _mm256_setr_epi64x(static_cast<long long>((first_row + 0) * sizeof(double)),
+                               static_cast<long long>((first_row + 1) * sizeof(double)),
+                               static_cast<long long>((first_row + 2) * sizeof(double)),
+                               static_cast<long long>((first_row + 3) * sizeof(double))),
+            _mm256_setr_epi64x(static_cast<long long>((first_row + 4) * sizeof(double)),
+                               static_cast<long long>((first_row + 5) * sizeof(double)),
+                               static_cast<long long>((first_row + 6) * sizeof(double)),
+                               static_cast<long long>((first_row + 7) * sizeof(double)))
+        };
+
+        while (true) {
+            int any = 0;
+            for (int half = 0; half < 2; ++half) {
+                const __m128i f = _mm_i32gather_epi32(feature, node[half], 4);
+                const __m128i active = _mm_cmpgt_epi32(f, minus_one);
+                const int mask = _mm_movemask_epi8(active);
+                any |= mask;
+                if (!mask) {
+                    continue;
+                }
+
+                const __m256i ptr = _mm256_i32gather_epi64(column, _mm_and_si128(f, active), 8);
+                const __m256d x = _mm256_mask_i64gather_pd(_mm256_setzero_pd(), nullptr,
+                                                           _mm256_add_epi64(ptr, row_bytes[half]), all, 1);
+                const __m256d threshold = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), nodes.threshold,
+                                                                   node[half], all, 8);
+                const __m256i right = _mm256_permutevar8x32_epi32(
+                        _mm256_castpd_si256(_mm256_cmp_pd(x, threshold, _CMP_GT_OQ)), lanes_to_half);
+                const __m128i next = _mm_sub_epi32(_mm_i32gather_epi32(child, node[half], 4),
+                                                   _mm256_castsi256_si128(right));
+                node[half] = _mm_blendv_epi8(node[half], next, active);
+            }
+
+            if (!any) {
+                break;
+            }
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(leaves), node[0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(leaves + 4), node[1]);
+    }
+
+    __attribute__((target("avx512f")))
+    void traverse_block_avx512(const Node_arrays &nodes, uint32_t root, const double *const *columns,
+                               size_t first_row, size_t, uint32_t *leaves)
+    {
+        const __m512i row_bytes = _mm512_add_epi64(
+                _mm512_set1_epi64(static_cast<long long>(first_row * sizeof(double))),
+                _mm512_setr_epi64(0, 8, 16, 24, 32, 40, 48, 56));
+        const __m512i minus_one = _mm512_set1_epi64(-1);
+        const __m512i one = _mm512_set1_epi64(1);
+        __m512i node = _mm512_set1_epi64(root);
+
+        while (true) {
+            const __m512i f = _mm512_cvtepi32_epi64(
+                    _mm512_mask_i64gather_epi32(_mm256_setzero_si256(), 0xFF, node, nodes.feature, 4));
+            const __mmask8 active = _mm512_cmpgt_epi64_mask(f, minus_one);
+            if (!active) {
+                break;
+            }
+
+            const __m512i ptr = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), active, f, columns, 8);
+            const __m512d x = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), active,
+                                                       _mm512_add_epi64(ptr, row_bytes), nullptr, 1);
+            const __m512d threshold = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xFF, node, nodes.threshold, 8);
+            const __mmask8 right = _mm512_mask_cmp_pd_mask(active, x, threshold, _CMP_GT_OQ);
+            __m512i next = _mm512_cvtepu32_epi64(
+                    _mm512_mask_i64gather_epi32(_mm256_setzero_si256(), 0xFF, node, nodes.child, 4));
+            next = _mm512_mask_add_epi64(next, right, next, one);
+            node = _mm512_mask_mov_epi64(node, active, next);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(leaves), _mm512_cvtepi64_epi32(node));
+    }
+#endif
+
+    /// Function that returns the block traversal implementing the requested kernel if the processor supports it
+    Block_kernel select_block_kernel(Inference_kernel kernel) {
+#if TREE_X86_KERNELS
+        __builtin_cpu_init();
+        if (kernel == Inference_kernel::avx512 && __builtin_cpu_supports("avx512f")) {
+            return traverse_block_avx512;
+        }
+        if (kernel == Inference_kernel::avx2 && __builtin_cpu_supports("avx2")) {
+            return traverse_block_avx2;
+        }
+#endif
+        return traverse_block_scalar;
+    }
+
+    std::atomic<Block_kernel> block_kernel(traverse_block_scalar); ///< Selected block traversal
+
+    constexpr char model_magic[8] = {'T', 'R', 'E', 'E', 'F', 'R', 'S', 'T'}; ///< First bytes of a model file
+    constexpr uint32_t model_version = 1;                                     ///< Version of the model file format
+    constexpr size_t model_alignment = 64;                                    ///< Alignment of the model file sections
+
+    /// Header of a model file, all fields are little-endian
+    struct Model_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t endian_tag;
+        uint64_t y_shape;
+        uint64_t features_count;
+        uint64_t trees_count;
+        uint64_t nodes_count;
+        uint64_t values_count;
+    };
+
+    static_assert(sizeof(Model_header) == 56, "Unexpected model header layout");
+
+    bool is_little_endian() {
+        const uint32_t value = 1;
+        unsigned char first;
+        std::memcpy(&first, &value, 1);
+
+        return first == 1;
+    }
+
+    /// Function that reverses the byte order of a value
+    template <typename T>
+    T swap_bytes(T value) {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        std::reverse(bytes, bytes + sizeof(T));
+        std::memcpy(&value, bytes, sizeof(T));
+
+        return value;
+    }
+
+    /// Function that converts a value between the host and the little-endian byte order
+    template <typename T>
+    T to_little_endian(T value) {
+        return is_little_endian() ? value : swap_bytes(value);
+    }
+
+    size_t align_up(size_t offset) {
+        return (offset + model_alignment - 1) / model_alignment * model_alignment;
+    }
+
+    /// Function that writes an array in the little-endian byte order padded to the section alignment
+    template <typename T>
+    void write_section(std::ofstream &out, const T *data, size_t size, size_t &offset) {
+        const std::vector<char> padding(align_up(offset) - offset, 0);
+        out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        offset += padding.size();
+
+        if (is_little_endian()) {
+            out.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size * sizeof(T)));
+        }
+        else {
+            for (size_t i = 0; i < size; ++i) {
+                const T value = swap_bytes(data[i]);
+                out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+            }
+        }
+        offset += size * sizeof(T);
+    }
+
+    /// Function that returns the position of the next section and checks that it fits into the file
+    size_t next_section(size_t &offset, size_t bytes, size_t file_size) {
+        const size_t begin = align_up(offset);
+        if (begin > file_size || bytes > file_size - begin) {
+            throw std::invalid_argument("Model file is truncated");
+        }
+        offset = begin + bytes;
+
+        return begin;
+    }
+
+    /// Function that copies a little-endian section into an owned array
+    template <typename T>
+    void read_section(const char *data, size_t size, std::vector<T> &ans) {
+        ans.resize(size);
+        std::memcpy(ans.data(), data, size * sizeof(T));
+
+        if (!is_little_endian()) {
+            for (auto &value : ans) {
+                value = swap_bytes(value);
+            }
+        }
+    }
+}
+
+Compiled_forest::Compiled_forest(const Compiled_forest &other)
+    : y_shape(other.y_shape), features_count(other.features_count), trees_count(other.trees_count),
+      nodes_count(other.nodes_count), values_count(other.values_count), roots(other.roots), feature(other.feature),
+      threshold(other.threshold), child(other.child), leaf_values(other.leaf_values), mapping(other.mapping),
+      arrays(other.arrays)
+{
+    if (!this->mapping) {
+        this->update_arrays();
+    }
+}
+
+Compiled_forest &Compiled_forest::operator=(const Compiled_forest &other) {
+    if (this != &other) {
+        Compiled_forest copy(other);
+        *this = std::move(copy);
+    }
+
+    return *this;
+}
+
+void Compiled_forest::save(const std::string &file_name) const {
+    std::ofstream out(file_name, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::invalid_argument("Failed to open file");
+    }
+
+    Model_header header = {};
+    std::memcpy(header.magic, model_magic, sizeof(model_magic));
+    header.version = to_little_endian(model_version);
+    header.endian_tag = to_little_endian<uint32_t>(0x01020304);
+    header.y_shape = to_little_endian<uint64_t>(this->y_shape);
+    header.features_count = to_little_endian<uint64_t>(this->features_count);
+    header.trees_count = to_little_endian<uint64_t>(this->trees_count);
+    header.nodes_count = to_little_endian<uint64_t>(this->nodes_count);
+    header.values_count = to_little_endian<uint64_t>(this->values_count);
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    size_t offset = sizeof(header);
+
+    const Arrays &a = this->arrays;
+    write_section(out, a.roots, this->trees_count, offset);
+    write_section(out, a.feature, this->nodes_count, offset);
+    write_section(out, a.threshold, this->nodes_count, offset);
+    write_section(out, a.child, this->nodes_count, offset);
+    write_section(out, a.leaf_values, this->values_count, offset);
+
+    if (!out.good()) {
+        throw std::invalid_argument("Failed to write file");
+    }
+}
+
+Compiled_forest Compiled_forest::load(const std::string &file_name) {
+    auto file = std::make_shared<const Mapped_file>(file_name);
+
+    Model_header header = {};
+    if (file->size() < sizeof(header)) {
+        throw std::invalid_argument("Model file is truncated");
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, model_magic, sizeof(model_magic)) != 0) {
+        throw std::invalid_argument("Not a model file");
+    }
+    if (to_little_endian(header.version) != model_version) {
+        throw std::invalid_argument("Unsupported model file version");
+    }
+    if (to_little_endian(header.endian_tag) != 0x01020304) {
+        throw std::invalid_argument("Invalid model file byte order");
+    }
+
+    Compiled_forest ans;
+    ans.y_shape = to_little_endian(header.y_shape);
+    ans.features_count = to_little_endian(header.features_count);
+    ans.trees_count = to_little_endian(header.trees_count);
+    ans.nodes_count = to_little_endian(header.nodes_count);
+    ans.values_count = to_little_endian(header.values_count);
+
+    const size_t limit = file->size();
+    if (ans.trees_count > limit || ans.nodes_count > limit || ans.values_count > limit) {
+        throw std::invalid_argument("Model file is truncated");
+    }
+
+    size_t offset = sizeof(header);
+    const char *data = file->data();
+    const char *roots = data + next_section(offset, ans.trees_count * sizeof(uint32_t), limit);
+    const char *feature = data + next_section(offset, ans.nodes_count * sizeof(int32_t), limit);
+    const char *threshold = data + next_section(offset, ans.nodes_count * sizeof(double), limit);
+    const char *child = data + next_section(offset, ans.nodes_count * sizeof(uint32_t), limit);
+    const char *leaf_values = data + next_section(offset, ans.values_count * sizeof(double), limit);
+
+    if (is_little_endian() && reinterpret_cast<uintptr_t>(data) % alignof(double) == 0) {
+        ans.arrays.roots = reinterpret_cast<const uint32_t *>(roots);
+        ans.arrays.feature = reinterpret_cast<const int32_t *>(feature);
+        ans.arrays.threshold = reinterpret_cast<const double *>(threshold);
+        ans.arrays.child = reinterpret_cast<const uint32_t *>(child);
+        ans.arrays.leaf_values = reinterpret_cast<const double *>(leaf_values);
+        ans.mapping = file;
+    }
+    else {
+        read_section(roots, ans.trees_count, ans.roots);
+        read_section(feature, ans.nodes_count, ans.feature);
+        read_section(threshold, ans.nodes_count, ans.threshold);
+        read_section(child, ans.nodes_count, ans.child);
+        read_section(leaf_values, ans.values_count, ans.leaf_values);
+        ans.update_arrays();
+    }
+
+    ans.validate();
+
+    return ans;
+}
+
+void Compiled_forest::append(const Compiled_forest &other) {
+    if (!other.trees_count) {
+        return;
+    }
+
+    this->detach();
+
+    if (this->roots.empty()) {
+        this->y_shape = other.y_shape;
+    }
+    else if (this->y_shape != other.y_shape) {
+        throw std::invalid_argument("All trees must have the same number of outputs");
+    }
+
+    const auto node_shift = static_cast<uint32_t>(this->feature.size());
+    const auto value_shift = static_cast<uint32_t>(this->leaf_values.size());
+    const Arrays &a = other.arrays;
+
+    for (size_t i = 0; i < other.trees_count; ++i) {
+        this->roots.push_back(a.roots[i] + node_shift);
+    }
+
+    for (size_t i = 0; i < other.nodes_count; ++i) {
+        this->feature.push_back(a.feature[i]);
+        this->threshold.push_back(a.threshold[i]);
+        this->child.push_back(a.child[i] + (a.feature[i] >= 0 ? node_shift : value_shift));
+    }
+
+    this->leaf_values.insert(this->leaf_values.end(), a.leaf_values, a.leaf_values + other.values_count);
+    this->features_count = std::max(this->features_count, other.features_count);
+    this->update_arrays();
+}
+
+void Compiled_forest::set_leaf_values(size_t tree, const Array_view &values, const std::vector<double> &leaf) {
+    if (tree >= this->trees_count || leaf.size() != this->y_shape) {
+        throw std::out_of_range("Out of range");
+    }
+
+    this->detach();
+
+    const auto offset = static_cast<size_t>(this->predict_tree(tree, values) - this->leaf_values.data());
+    std::copy(leaf.begin(), leaf.end(), this->leaf_values.begin() + offset);
+}
+
+void Compiled_forest::detach() {
+    if (!this->mapping) {
+        return;
+    }
+
+    const Arrays &a = this->arrays;
+    this->roots.assign(a.roots, a.roots + this->trees_count);
+    this->feature.assign(a.feature, a.feature + this->nodes_count);
+    this->threshold.assign(a.threshold, a.threshold + this->nodes_count);
+    this->child.assign(a.child, a.child + this->nodes_count);
+    this->leaf_values.assign(a.leaf_values, a.leaf_values + this->values_count);
+    this->mapping.reset();
+    this->update_arrays();
+}
+
+void Compiled_forest::update_arrays() {
+    this->trees_count = this->roots.size();
+    this->nodes_count = this->feature.size();
+    this->values_count = this->leaf_values.size();
+
+    this->arrays.roots = this->roots.data();
+    this->arrays.feature = this->feature.data();
+    this->arrays.threshold = this->threshold.data();
+    this->arrays.child = this->child.data();
+    this->arrays.leaf_values = this->leaf_values.data();
+}
+
+void Compiled_forest::validate() const {
+    const Arrays &a = this->arrays;
+
+    // Leaves of at least one tree hold y_shape values each, which also keeps the leaf check below from wrapping
+    if ((this->trees_count && !this->y_shape) || this->y_shape > this->values_count) {
+        throw std::invalid_argument("Invalid model file");
+    }
+
+    for (size_t i = 0; i < this->trees_count; ++i) {
+        if (a.roots[i] >= this->nodes_count) {
+            throw std::invalid_argument("Invalid model file");
+        }
+    }
+
+    for (size_t i = 0; i < this->nodes_count; ++i) {
+        if (a.feature[i] >= 0) {
+            // Children follow their parent, so every path reaches a leaf
+            if (static_cast<size_t>(a.feature[i]) >= this->features_count || a.child[i] <= i ||
+                static_cast<size_t>(a.child[i]) + 1 >= this->nodes_count) {
+                throw std::invalid_argument("Invalid model file");
+            }
+        }
+        else if (a.feature[i] != -1 || a.child[i] > this->values_count - this->y_shape) {
+            throw std::invalid_argument("Invalid model file");
+        }
+    }
+}
+
+void Compiled_forest::predict(const Array_view &values, double *ans) const {
+    std::fill(ans, ans + this->y_shape, 0.0);
+
+    for (size_t tree = 0; tree < this->trees_count; ++tree) {
+        const double *leaf = this->predict_tree(tree, values);
+
+        for (size_t j = 0; j < this->y_shape; ++j) {
+            ans[j] += leaf[j] / static_cast<double>(this->trees_count);
+        }
+    }
+}
+
+std::vector<double> Compiled_forest::predict(const std::vector<double> &values) const {
+    if (values.size() < this->features_count) {
+        throw std::out_of_range("Out of range");
+    }
+
+    std::vector<double> ans(this->y_shape, 0.0);
+    this->predict(Array_view(values.data(), values.size()), ans.data());
+
+    return ans;
+}
+
+Matrix Compiled_forest::predict(const Table &values) const {
+    if (values.get_columns_count() < this->features_count) {
+        throw std::out_of_range("Out of range");
+    }
+
+    Matrix ans(values.get_rows_count(), this->y_shape);
+    double *out = ans.row_data(0);
+    const size_t n_rows = ans.get_rows_count();
+
+    std::vector<const double*> columns(values.get_columns_count());
+    for (size_t i = 0; i < columns.size(); ++i) {
+        columns[i] = values.column(i).data();
+    }
+
+    const auto n_tiles = static_cast<long long>((n_rows + predict_tile_rows - 1) / predict_tile_rows);
+
+    // Tiles accumulate straight into their rows of the result, rows of one tile are contiguous
+#pragma omp parallel for schedule(dynamic) default(none) shared(columns, out, n_rows, n_tiles)
+    for (long long t = 0; t < n_tiles; ++t) {
+        const size_t first_row = static_cast<size_t>(t) * predict_tile_rows;
+        const size_t count = std::min(predict_tile_rows, n_rows - first_row);
+
+        this->predict_rows(columns.data(), first_row, count, 0, this->trees_count, out + first_row * this->y_shape);
+    }
+
+    return ans;
+}
+
+void Compiled_forest::predict_rows(const double *const *columns, size_t first_row, size_t count,
+                                   size_t tree_begin, size_t tree_end, double *ans) const
+{
+    const Block_kernel kernel = block_kernel.load(std::memory_order_relaxed);
+    const Arrays &a = this->arrays;
+    const Node_arrays nodes = {a.feature, a.threshold, a.child};
+    const auto n_trees = static_cast<double>(this->trees_count);
+    uint32_t leaves[block_size];
+
+    for (size_t tree = tree_begin; tree < tree_end; ++tree) {
+        for (size_t start = 0; start < count; start += block_size) {
+            const size_t size = std::min(block_size, count - start);
+
+            if (size == block_size) {
+                kernel(nodes, a.roots[tree], columns, first_row + start, size, leaves);
+            }
+            else {
+                traverse_block_scalar(nodes, a.roots[tree], columns, first_row + start, size, leaves);
+            }
+
+            for (size_t i = 0; i < size; ++i) {
+                const double *leaf = a.leaf_values + a.child[leaves[i]];
+                double *out = ans + (start + i) * this->y_shape;
+
+                for (size_t j = 0; j < this->y_shape; ++j) {
+                    out[j] += leaf[j] / n_trees;
+                }
+            }
+        }
+    }
+}
+
+void Compiled_forest::set_inference_kernel(Inference_kernel kernel) {
+    block_kernel.store(select_block_kernel(kernel));
+}
+
+size_t Compiled_forest::get_trees_count() const {
+    return this->trees_count;
+}
+
+size_t Compiled_forest::get_y_shape() const {
+    return this->y_shape;
+}
+
+size_t Compiled_forest::get_features_count() const {
+    return this->features_count;
+}
+
+size_t Compiled_forest::get_nodes_count() const {
+    return this->nodes_count;
+}
+
+constexpr size_t Compiled_forest::predict_tile_rows;
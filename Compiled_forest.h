@@ -0,0 +1,206 @@
+#ifndef TREE_COMPILED_FOREST_H
+#define TREE_COMPILED_FOREST_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+#include "Array_view.h"
+#include "Mapped_file.h"
+#include "Table.h"
+#include "Matrix.h"
+
+/// Implementation of the batch tree traversal
+enum class Inference_kernel {
+    automatic, ///< Fastest kernel measured on common hardware (currently the interleaved scalar one)
+    scalar,    ///< Interleaved scalar traversal of a block of rows
+    avx2,      ///< AVX2 gathers and compares, four rows per vector
+    avx512     ///< AVX-512 gathers and compares, eight rows per vector
+};
+
+/// Flat inference representation of one or several trained trees
+///
+/// Nodes of every tree are stored breadth-first as a structure of arrays, the children of a node are
+/// neighbours (the right child follows the left one), leaf predictions live in one contiguous pool.
+/// The arrays are either owned or point directly into a memory-mapped model file.
+class Compiled_forest {
+public:
+    Compiled_forest() = default;
+
+    Compiled_forest(const Compiled_forest &other);
+    Compiled_forest(Compiled_forest &&other) = default;
+    Compiled_forest& operator=(const Compiled_forest &other);
+    Compiled_forest& operator=(Compiled_forest &&other) = default;
+
+    /// Function that writes the forest to a binary model file
+    ///
+    /// The format is versioned and little-endian regardless of the host, every array starts on a
+    /// 64-byte boundary so that it can be used in place after mapping the file.
+    void save(
+        const std::string &file_name ///< The path to the file
+    ) const;
+
+    /// Function that maps a binary model file into memory, inference runs directly on the mapped arrays
+    static Compiled_forest load(
+        const std::string &file_name ///< The path to the file
+    );
+
+    /// Function that appends a trained tree given by its root node
+    template <typename Node>
+    void add_tree(
+        const Node &root ///< Root node of the tree
+    );
+
+    /// Function that appends all trees of another compiled forest
+    void append(
+        const Compiled_forest &other ///< Compiled forest with the same number of outputs
+    );
+
+    /// Function that replaces the prediction of the leaf of one tree reached by a feature set
+    void set_leaf_values(
+        size_t tree,                    ///< Tree index
+        const Array_view &values,       ///< One feature set
+        const std::vector<double> &leaf ///< New prediction of the leaf (y_shape values)
+    );
+
+    /// Function that returns the leaf prediction of one tree for a feature set
+    const double* predict_tree(
+        size_t tree,             ///< Tree index
+        const Array_view &values ///< One feature set
+    ) const {
+        const Arrays &a = this->arrays;
+        uint32_t node = a.roots[tree];
+
+        while (a.feature[node] >= 0) {
+            node = a.child[node] + (values[a.feature[node]] > a.threshold[node]);
+        }
+
+        return a.leaf_values + a.child[node];
+    }
+
+    /// Prediction function for one set of features (mean of all tree predictions)
+    void predict(
+        const Array_view &values, ///< One feature set
+        double *ans               ///< Output array of y_shape values
+    ) const;
+
+    /// Prediction function for one set of features (mean of all tree predictions)
+    std::vector<double> predict(
+        const std::vector<double> &values ///< One feature set
+    ) const;
+
+    /// Prediction function for multiple feature sets, rows are processed in parallel tiles
+    Matrix predict(
+        const Table &values ///< Multiple feature sets
+    ) const;
+
+    /// Function that adds the mean prediction share of a range of trees for consecutive rows of columnar data
+    ///
+    /// Rows are pushed through every tree in blocks in lockstep by the kernel chosen with set_inference_kernel.
+    void predict_rows(
+        const double *const *columns, ///< Pointers to the beginning of each feature column
+        size_t first_row,             ///< Index of the first row in the columns
+        size_t count,                 ///< Number of rows
+        size_t tree_begin,            ///< First tree of the range
+        size_t tree_end,              ///< End of the tree range
+        double *ans                   ///< Output matrix of count x y_shape values (added to)
+    ) const;
+
+    /// Function that selects the batch traversal kernel for all compiled forests
+    ///
+    /// Kernels not supported by the processor fall back to the scalar one.
+    static void set_inference_kernel(
+        Inference_kernel kernel ///< Requested kernel
+    );
+
+    /// Function that returns the number of trees
+    size_t get_trees_count() const;
+
+    /// Function that returns the number of outputs
+    size_t get_y_shape() const;
+
+    /// Function that returns the minimum number of features required for prediction
+    size_t get_features_count() const;
+
+    /// Function that returns the total number of nodes
+    size_t get_nodes_count() const;
+
+private:
+    /// Pointers to the arrays used for inference
+    struct Arrays {
+        const uint32_t *roots = nullptr;
+        const int32_t *feature = nullptr;
+        const double *threshold = nullptr;
+        const uint32_t *child = nullptr;
+        const double *leaf_values = nullptr;
+    };
+
+    /// Function that copies mapped arrays into owned ones before the forest is modified
+    void detach();
+
+    /// Function that points the inference arrays to the owned ones
+    void update_arrays();
+
+    /// Function that checks that all node references stay inside the arrays
+    void validate() const;
+
+    constexpr static size_t predict_tile_rows = 256; ///< Number of rows pushed through all trees by one task
+
+    size_t y_shape = 0;                        ///< Number of outputs
+    size_t features_count = 0;                 ///< Largest used feature index plus one
+    size_t trees_count = 0;                    ///< Number of trees
+    size_t nodes_count = 0;                    ///< Number of nodes of all trees
+    size_t values_count = 0;                   ///< Number of leaf values
+    std::vector<uint32_t> roots;               ///< Index of the root node of each tree
+    std::vector<int32_t> feature;              ///< Split feature of each node (-1 for leaves)
+    std::vector<double> threshold;             ///< Split value of each node
+    std::vector<uint32_t> child;               ///< Index of the left child, or the offset of the leaf values for leaves
+    std::vector<double> leaf_values;           ///< Leaf predictions, y_shape values per leaf
+    std::shared_ptr<const Mapped_file> mapping; ///< Model file the arrays point into (if loaded)
+    Arrays arrays;                             ///< Arrays used for inference (owned or mapped)
+};
+
+template <typename Node>
+void Compiled_forest::add_tree(const Node &root) {
+    this->detach();
+
+    if (this->roots.empty()) {
+        this->y_shape = root.ymean.size();
+    }
+    else if (this->y_shape != root.ymean.size()) {
+        throw std::invalid_argument("All trees must have the same number of outputs");
+    }
+
+    const auto first = static_cast<uint32_t>(this->feature.size());
+    this->roots.push_back(first);
+
+    std::vector<const Node*> queue(1, &root);
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const Node &node = *queue[head];
+
+        if (node.best_feature != -1 && node.left && node.right) {
+            this->feature.push_back(node.best_feature);
+            this->threshold.push_back(node.best_value);
+            this->child.push_back(first + static_cast<uint32_t>(queue.size()));
+            queue.push_back(node.left);
+            queue.push_back(node.right);
+
+            if (static_cast<size_t>(node.best_feature) + 1 > this->features_count) {
+                this->features_count = node.best_feature + 1;
+            }
+        }
+        else {
+            this->feature.push_back(-1);
+            this->threshold.push_back(0.0);
+            this->child.push_back(static_cast<uint32_t>(this->leaf_values.size()));
+            this->leaf_values.insert(this->leaf_values.end(), node.ymean.begin(), node.ymean.end());
+        }
+    }
+
+    this->update_arrays();
+}
+
+
+#endif //TREE_COMPILED_FOREST_H
@@ -0,0 +1,143 @@
+#include "Csv_parser.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+
+std::vector<char> parse_csv_header(const std::string &header, char delim,
+                                   const std::unordered_set<std::string> &ignored_columns)
+{
+    std::vector<char> ans;
+    std::istringstream inp(header.empty() || header.back() != '\r' ? header : header.substr(0, header.size() - 1));
+
+    for (std::string name; std::getline(inp, name, delim);) {
+        ans.push_back(ignored_columns.find(name) == ignored_columns.end());
+    }
+
+    if (ignored_columns.size() >= ans.size()) {
+        throw std::invalid_argument("The number of columns to be ignored is greater or equal than the total number of columns");
+    }
+
+    return ans;
+}
+
+bool parse_double(const char *begin, const char *end, double &ans) {
+    constexpr static double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    constexpr uint64_t max_exact = uint64_t(1) << 53;
+
+    const char *p = begin;
+    const bool negative = p != end && *p == '-';
+    if (p != end && (*p == '-' || *p == '+')) {
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false, truncated = false;
+
+    for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+        any = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            digits += mantissa != 0;
+        }
+        else {
+            ++exponent;
+            truncated |= *p != '0';
+        }
+    }
+
+    if (p != end && *p == '.') {
+        for (++p; p != end && *p >= '0' && *p <= '9'; ++p) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                digits += mantissa != 0;
+                --exponent;
+            }
+            else {
+                truncated |= *p != '0';
+            }
+        }
+    }
+
+    if (any && p != end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        const bool negative_exponent = q != end && *q == '-';
+        if (q != end && (*q == '-' || *q == '+')) {
+            ++q;
+        }
+
+        int value = 0;
+        const char *first = q;
+        for (; q != end && *q >= '0' && *q <= '9'; ++q) {
+            value = value < 100000 ? value * 10 + (*q - '0') : value;
+        }
+
+        if (q != first) {
+            exponent += negative_exponent ? -value : value;
+            p = q;
+        }
+    }
+
+    if (any && p == end && !truncated && mantissa <= max_exact && exponent >= -22 && exponent <= 22) {
+        const auto value = static_cast<double>(mantissa);
+        ans = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+        ans = negative ? -ans : ans;
+        return true;
+    }
+
+    // Rare forms (long mantissas, large exponents, inf, nan) are handled by the standard library
+    const auto size = static_cast<size_t>(end - begin);
+    char buffer[64];
+    std::string long_field;
+    char *field = buffer;
+
+    if (size < sizeof(buffer)) {
+        std::memcpy(buffer, begin, size);
+        buffer[size] = '\0';
+    }
+    else {
+        long_field.assign(begin, end);
+        field = &long_field[0];
+    }
+
+    char *parsed = nullptr;
+    ans = std::strtod(field, &parsed);
+
+    return size && parsed == field + size;
+}
+
+size_t parse_csv_line(const char *begin, const char *end, char delim, const std::vector<char> &keep,
+                      double *values)
+{
+    size_t field = 0;
+
+    for (const char *p = begin;; ++field) {
+        const auto *next = static_cast<const char *>(std::memchr(p, delim, static_cast<size_t>(end - p)));
+        const char *field_end = next ? next : end;
+
+        if (field < keep.size() && keep[field]) {
+            const char *b = p, *e = field_end;
+            while (b != e && (*b == ' ' || *b == '\t' || *b == '"')) {
+                ++b;
+            }
+            while (e != b && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '"' || e[-1] == '\r')) {
+                --e;
+            }
+
+            if (!parse_double(b, e, *values++)) {
+                throw std::invalid_argument("Failed to parse value '" + std::string(p, field_end) + "'");
+            }
+        }
+
+        if (!next) {
+            return field + 1;
+        }
+        p = next + 1;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef TREE_CSV_PARSER_H
+#define TREE_CSV_PARSER_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <unordered_set>
+
+/// Function that resolves the fields to parse from the header line (non-zero for kept columns)
+std::vector<char> parse_csv_header(
+    const std::string &header,                             ///< Header line with the column names
+    char delim,                                            ///< Separator between column names
+    const std::unordered_set<std::string> &ignored_columns ///< Ignored column names
+);
+
+/// Function that parses a whole field as a floating point number without allocating memory
+///
+/// Short decimal numbers are converted exactly by integer arithmetic, other forms fall back to std::strtod.
+/// Returns false if the field is not a number.
+bool parse_double(
+    const char *begin, ///< Beginning of the field
+    const char *end,   ///< End of the field
+    double &ans        ///< Parsed value
+);
+
+/// Function that parses the kept fields of one line of delimited text, returns the number of fields in the line
+///
+/// Fields are trimmed of spaces and quotes, a field that is kept but is not a number raises std::invalid_argument.
+size_t parse_csv_line(
+    const char *begin,             ///< Beginning of the line (without the line break)
+    const char *end,               ///< End of the line
+    char delim,                    ///< Separator between fields
+    const std::vector<char> &keep, ///< Non-zero for the fields to parse
+    double *values                 ///< Output array, one value per kept field
+);
+
+
+#endif //TREE_CSV_PARSER_H
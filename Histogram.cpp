@@ -0,0 +1,244 @@
+#include "Histogram.h"
+
+#include <algorithm>
+#include <random>
+#include "Profiler.h"
+
+void Binned_features::build(const Table &x) {
+    Phase_timer timer(Phase::binning);
+    this->rows = x.get_rows_count();
+    this->bounds.assign(x.get_columns_count(), {});
+    this->data.assign(this->rows * x.get_columns_count(), 0);
+
+    for (size_t feature = 0; feature < this->bounds.size(); ++feature) {
+        const Array_view arr = x.column(feature);
+        std::vector<double> values(arr.data(), arr.data() + arr.size());
+        std::sort(values.begin(), values.end());
+
+        this->bounds[feature] = get_bounds(values, max_bins);
+        this->encode(feature, arr, 0);
+    }
+}
+
+void Binned_features::build(Table_stream &x) {
+    Phase_timer timer(Phase::binning);
+    const size_t columns = x.get_columns_count();
+    std::vector<std::vector<double>> samples(columns);
+    std::mt19937_64 gen(columns);
+
+    // First pass: row count and a reservoir sample of every feature
+    this->rows = 0;
+    for (x.rewind(); x.next();) {
+        const Table &block = x.block();
+
+        for (size_t i = 0; i < block.get_rows_count(); ++i, ++this->rows) {
+            if (this->rows < max_samples) {
+                for (size_t feature = 0; feature < columns; ++feature) {
+                    samples[feature].push_back(block.column(feature)[i]);
+                }
+                continue;
+            }
+
+            const auto slot = std::uniform_int_distribution<size_t>(0, this->rows)(gen);
+            if (slot < max_samples) {
+                for (size_t feature = 0; feature < columns; ++feature) {
+                    samples[feature][slot] = block.column(feature)[i];
+                }
+            }
+        }
+    }
+
+    this->bounds.assign(columns, {});
+    this->data.assign(this->rows * columns, 0);
+
+    for (size_t feature = 0; feature < columns; ++feature) {
+        std::sort(samples[feature].begin(), samples[feature].end());
+        this->bounds[feature] = get_bounds(samples[feature], max_bins);
+    }
+
+    // Second pass: bin codes
+    for (x.rewind(); x.next();) {
+        for (size_t feature = 0; feature < columns; ++feature) {
+            this->encode(feature, x.block().column(feature), x.get_block_first_row());
+        }
+    }
+}
+
+std::vector<double> Binned_features::get_bounds(const std::vector<double> &values, size_t bins) {
+    std::vector<double> distinct;
+    std::vector<size_t> counts;
+    for (const auto &value : values) {
+        if (distinct.empty() || distinct.back() != value) {
+            distinct.push_back(value);
+            counts.push_back(0);
+        }
+        ++counts.back();
+    }
+
+    std::vector<double> ans;
+    if (distinct.size() <= bins) {
+        for (size_t i = 0; i + 1 < distinct.size(); ++i) {
+            ans.push_back(distinct[i + 1] / 2 + distinct[i] / 2);
+        }
+    }
+    else {
+        size_t accumulated = 0;
+        for (size_t i = 0; i + 1 < distinct.size() && ans.size() + 1 < bins; ++i) {
+            accumulated += counts[i];
+            if (accumulated * bins >= (ans.size() + 1) * values.size()) {
+                ans.push_back(distinct[i + 1] / 2 + distinct[i] / 2);
+            }
+        }
+    }
+
+    return ans;
+}
+
+void Binned_features::encode(size_t feature, const Array_view &arr, size_t first_row) {
+    const std::vector<double> &bound = this->bounds[feature];
+    uint8_t *code = this->data.data() + feature * this->rows + first_row;
+
+    for (size_t i = 0; i < arr.size(); ++i) {
+        code[i] = static_cast<uint8_t>(std::lower_bound(bound.begin(), bound.end(), arr[i]) - bound.begin());
+    }
+}
+
+const uint8_t *Binned_features::codes(size_t feature) const {
+    return this->data.data() + feature * this->rows;
+}
+
+size_t Binned_features::get_bins_count(size_t feature) const {
+    return this->bounds[feature].size() + 1;
+}
+
+double Binned_features::get_bound(size_t feature, size_t bin) const {
+    return this->bounds[feature][bin];
+}
+
+size_t Binned_features::get_features_count() const {
+    return this->bounds.size();
+}
+
+size_t Binned_features::get_rows_count() const {
+    return this->rows;
+}
+
+Histogram::Histogram(const Binned_features &bins, size_t y_shape) : y_shape(y_shape) {
+    size_t size = 0;
+    this->offsets.reserve(bins.get_features_count());
+
+    for (size_t feature = 0; feature < bins.get_features_count(); ++feature) {
+        this->offsets.push_back(size);
+        size += bins.get_bins_count(feature) * (this->y_shape + 1);
+    }
+
+    this->data.assign(size, 0.0);
+}
+
+void Histogram::build(const Binned_features &bins, const Matrix &y, const int *rows, size_t count) {
+    Phase_timer timer(Phase::histogram);
+    const size_t stride = this->y_shape + 1;
+    std::fill(this->data.begin(), this->data.end(), 0.0);
+
+    for (size_t feature = 0; feature < this->offsets.size(); ++feature) {
+        const uint8_t *codes = bins.codes(feature);
+        double *hist = this->data.data() + this->offsets[feature];
+
+        for (size_t i = 0; i < count; ++i) {
+            double *bin = hist + codes[rows[i]] * stride;
+            const double *row = y.row_data(rows[i]);
+
+            bin[0] += 1.0;
+            for (size_t j = 0; j < this->y_shape; ++j) {
+                bin[j + 1] += row[j];
+            }
+        }
+    }
+}
+
+void Histogram::build_level(const std::vector<Histogram*> &hists, size_t feature, const Binned_features &bins,
+                            const Matrix &y, const int *rows, const int *nodes, size_t count)
+{
+    Phase_timer timer(Phase::histogram);
+    const size_t outputs = y.get_columns_count();
+    const size_t stride = outputs + 1;
+    const uint8_t *codes = bins.codes(feature);
+
+    std::vector<double*> bases(hists.size(), nullptr);
+    for (size_t k = 0; k < hists.size(); ++k) {
+        if (hists[k]) {
+            bases[k] = hists[k]->data.data() + hists[k]->offsets[feature];
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        double *bin = bases[nodes[i]] + codes[rows[i]] * stride;
+        const double *row = y.row_data(rows[i]);
+
+        bin[0] += 1.0;
+        for (size_t j = 0; j < outputs; ++j) {
+            bin[j + 1] += row[j];
+        }
+    }
+}
+
+void Histogram::subtract(const Histogram &other) {
+    Phase_timer timer(Phase::histogram);
+    for (size_t i = 0; i < this->data.size(); ++i) {
+        this->data[i] -= other.data[i];
+    }
+}
+
+size_t Histogram::get_features_count() const {
+    return this->offsets.size();
+}
+
+void Histogram::scan_feature(size_t feature, size_t count, const Target_sums &sums, long double &mse_base,
+                             std::pair<int, int> &ans) const
+{
+    Phase_timer timer(Phase::split_scan);
+    const size_t stride = this->y_shape + 1;
+    const double *hist = this->data.data() + this->offsets[feature];
+    const size_t n_bins = ((feature + 1 < this->offsets.size() ? this->offsets[feature + 1] : this->data.size())
+                           - this->offsets[feature]) / stride;
+    const long double n = sums.n;
+
+    long double sum2 = 0;
+    std::vector<long double> total(this->y_shape), left(this->y_shape, 0);
+    for (size_t j = 0; j < this->y_shape; ++j) {
+        sum2 += sums.sum2[j];
+        total[j] = sums.sum[j] * n;
+    }
+
+    long double NLeft = 0;
+    const auto NTotal = static_cast<long double>(count);
+
+    for (size_t bin = 0; bin + 1 < n_bins; ++bin) {
+        const double *cur = hist + bin * stride;
+        if (cur[0] < 0.5) {
+            continue;
+        }
+
+        NLeft += cur[0];
+        for (size_t j = 0; j < this->y_shape; ++j) {
+            left[j] += cur[j + 1];
+        }
+
+        const long double NRight = NTotal - NLeft;
+        if (NRight < 0.5) {
+            break;
+        }
+
+        long double mse_split = sum2;
+        for (size_t j = 0; j < this->y_shape; ++j) {
+            const long double right = total[j] - left[j];
+            mse_split -= left[j] * left[j] / (n * NLeft) + right * right / (n * NRight);
+        }
+
+        if (mse_split < mse_base) {
+            ans.first = static_cast<int>(feature);
+            ans.second = static_cast<int>(bin);
+            mse_base = mse_split;
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef TREE_HISTOGRAM_H
+#define TREE_HISTOGRAM_H
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "Table.h"
+#include "Table_stream.h"
+#include "Split_search.h"
+
+/// Table features quantized into at most 256 bins, stored as one byte per value
+class Binned_features {
+public:
+    constexpr static size_t max_bins = 256;       ///< Maximum number of bins per feature
+    constexpr static size_t max_samples = 1 << 16; ///< Number of values per feature sampled to bin a stream
+
+    /// Function that calculates the bin bounds of every feature and quantizes the table
+    void build(
+        const Table &x ///< Feature set
+    );
+
+    /// Function that quantizes a streamed table in two passes over its blocks
+    ///
+    /// The bin bounds are calculated from a uniform sample of each feature, so only the bin codes
+    /// (one byte per value) are kept in memory.
+    void build(
+        Table_stream &x ///< Streamed feature set
+    );
+
+    /// Function that returns the bin codes of a feature column
+    const uint8_t* codes(
+        size_t feature ///< Feature index
+    ) const;
+
+    /// Function that returns the number of bins of a feature
+    size_t get_bins_count(
+        size_t feature ///< Feature index
+    ) const;
+
+    /// Function that returns the split value separating a bin from the next one
+    double get_bound(
+        size_t feature, ///< Feature index
+        size_t bin      ///< Bin index
+    ) const;
+
+    /// Function that returns the number of features
+    size_t get_features_count() const;
+
+    /// Function that returns the number of quantized rows
+    size_t get_rows_count() const;
+
+private:
+    /// Function that calculates the bin bounds of a feature from its sorted values
+    static std::vector<double> get_bounds(
+        const std::vector<double> &values, ///< Sorted feature values
+        size_t bins                        ///< Maximum number of bins
+    );
+
+    /// Function that quantizes consecutive values of a feature
+    void encode(
+        size_t feature,        ///< Feature index
+        const Array_view &arr, ///< Feature values
+        size_t first_row       ///< Row index of the first value
+    );
+
+private:
+    size_t rows = 0;                                       ///< Number of quantized rows
+    std::vector<std::vector<double>> bounds;               ///< Upper bounds of all bins except the last for each feature
+    std::vector<uint8_t, Aligned_allocator<uint8_t>> data; ///< Bin codes stored column by column
+};
+
+/// Sums of node observations over the bins of every feature
+class Histogram {
+public:
+    Histogram() = default;
+
+    Histogram(
+        const Binned_features &bins, ///< Quantized feature set
+        size_t y_shape               ///< Number of outputs
+    );
+
+    /// Function that accumulates the observations of the selected rows
+    void build(
+        const Binned_features &bins, ///< Quantized feature set
+        const Matrix &y,             ///< Feature-related observations
+        const int *rows,             ///< Selected row indices
+        size_t count                 ///< Number of selected rows
+    );
+
+    /// Function that accumulates one feature of the observations of all nodes of a tree level in one pass
+    static void build_level(
+        const std::vector<Histogram*> &hists, ///< Histogram of every level node (nullptr - not built)
+        size_t feature,                       ///< Feature index
+        const Binned_features &bins,          ///< Quantized feature set
+        const Matrix &y,                      ///< Feature-related observations
+        const int *rows,                      ///< Selected row indices
+        const int *nodes,                     ///< Level node of every selected row (its histogram must be built)
+        size_t count                          ///< Number of selected rows
+    );
+
+    /// Function that subtracts another histogram (turns the parent histogram into the sibling one)
+    void subtract(
+        const Histogram &other ///< Histogram of a subset of rows
+    );
+
+    /// Function that returns the number of features
+    size_t get_features_count() const;
+
+    /// Function of searching for the best split bin of one feature
+    void scan_feature(
+        size_t feature,          ///< Feature index
+        size_t count,            ///< Number of node rows
+        const Target_sums &sums, ///< Sums of the node observations
+        long double &mse_base,   ///< Best mean square error found so far
+        std::pair<int, int> &ans ///< Best feature and bin found so far
+    ) const;
+
+private:
+    size_t y_shape = 0;          ///< Number of outputs
+    std::vector<size_t> offsets; ///< Offset of the first bin of each feature
+    std::vector<double> data;    ///< Row count followed by the sums of observations for every bin
+};
+
+
+#endif //TREE_HISTOGRAM_H
@@ -0,0 +1,67 @@
+#include "Mapped_file.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TREE_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define TREE_HAS_MMAP 0
+#endif
+
+Mapped_file::Mapped_file(const std::string &file_name) {
+#if TREE_HAS_MMAP
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::invalid_argument("Failed to open file");
+    }
+
+    struct stat info = {};
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::invalid_argument("Failed to open file");
+    }
+
+    this->length = static_cast<size_t>(info.st_size);
+    if (this->length) {
+        void *addr = mmap(nullptr, this->length, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::invalid_argument("Failed to map file");
+        }
+        this->ptr = static_cast<const char *>(addr);
+    }
+
+    close(fd);
+#else
+    std::ifstream inp(file_name, std::ios::binary);
+    if (!inp.is_open()) {
+        throw std::invalid_argument("Failed to open file");
+    }
+
+    this->buffer.assign(std::istreambuf_iterator<char>(inp), std::istreambuf_iterator<char>());
+    this->ptr = this->buffer.data();
+    this->length = this->buffer.size();
+#endif
+}
+
+Mapped_file::~Mapped_file() {
+#if TREE_HAS_MMAP
+    if (this->ptr) {
+        munmap(const_cast<char *>(this->ptr), this->length);
+    }
+#endif
+}
+
+const char *Mapped_file::data() const {
+    return this->ptr;
+}
+
+size_t Mapped_file::size() const {
+    return this->length;
+}
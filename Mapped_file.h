@@ -0,0 +1,35 @@
+#ifndef TREE_MAPPED_FILE_H
+#define TREE_MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/// Read-only file mapped into memory
+///
+/// On systems without mmap the file contents are read into memory instead.
+class Mapped_file {
+public:
+    explicit Mapped_file(
+        const std::string &file_name ///< The path to the file
+    );
+
+    ~Mapped_file();
+
+    Mapped_file(const Mapped_file &) = delete;
+    Mapped_file& operator=(const Mapped_file &) = delete;
+
+    /// Function that returns a pointer to the beginning of the file contents
+    const char* data() const;
+
+    /// Function that returns the file size in bytes
+    size_t size() const;
+
+private:
+    const char *ptr = nullptr; ///< Beginning of the file contents
+    size_t length = 0;         ///< File size in bytes
+    std::vector<char> buffer;  ///< File contents when the file could not be mapped
+};
+
+
+#endif //TREE_MAPPED_FILE_H
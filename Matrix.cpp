@@ -0,0 +1,123 @@
+#include "Matrix.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+Matrix::Matrix(size_t rows, size_t columns, double value) :
+        rows(rows), columns(columns), storage(std::make_shared<std::vector<double>>(rows * columns, value)) {}
+
+Matrix::Matrix(const std::vector<std::vector<double>> &rows) {
+    if (rows.empty()) {
+        return;
+    }
+
+    this->columns = rows.front().size();
+    this->storage->reserve(rows.size() * this->columns);
+
+    for (const auto &row : rows) {
+        this->push_back_row(row);
+    }
+}
+
+Matrix::operator std::vector<std::vector<double>>() const {
+    return this->to_vectors();
+}
+
+double *Matrix::row_data(size_t row) {
+    this->detach();
+    return this->storage->data() + row * this->columns;
+}
+
+Array_view Matrix::row(size_t row) const {
+    return Array_view(this->row_data(row), this->columns);
+}
+
+Array_view Matrix::column(size_t column) const {
+    return Array_view(this->storage->data() + column, this->rows, this->columns);
+}
+
+std::vector<double> Matrix::get_row(size_t row) const {
+    if (row >= this->rows) {
+        throw std::out_of_range("Out of range");
+    }
+
+    return std::vector<double>(this->row_data(row), this->row_data(row) + this->columns);
+}
+
+Matrix Matrix::prefix(size_t rows) const {
+    if (rows > this->rows) {
+        throw std::out_of_range("Out of range");
+    }
+
+    Matrix ans(*this);
+    ans.rows = rows;
+
+    return ans;
+}
+
+void Matrix::push_back_row(const std::vector<double> &row) {
+    if (!this->rows && !this->columns) {
+        this->columns = row.size();
+    }
+    else if (row.size() != this->columns) {
+        throw std::invalid_argument("All rows must have the same number of columns");
+    }
+
+    this->detach();
+    this->storage->insert(this->storage->end(), row.begin(), row.end());
+    ++this->rows;
+}
+
+void Matrix::append(const Matrix &other) {
+    if (other.empty()) {
+        return;
+    }
+
+    if (!this->rows && !this->columns) {
+        this->columns = other.columns;
+    }
+    else if (other.columns != this->columns) {
+        throw std::invalid_argument("All rows must have the same number of columns");
+    }
+
+    this->detach();
+    this->storage->insert(this->storage->end(), other.data(), other.data() + other.rows * other.columns);
+    this->rows += other.rows;
+}
+
+double &Matrix::at(size_t row, size_t column) {
+    if (row >= this->rows || column >= this->columns) {
+        throw std::out_of_range("Out of range");
+    }
+
+    return this->row_data(row)[column];
+}
+
+const double &Matrix::at(size_t row, size_t column) const {
+    if (row >= this->rows || column >= this->columns) {
+        throw std::out_of_range("Out of range");
+    }
+
+    return this->row_data(row)[column];
+}
+
+std::vector<std::vector<double>> Matrix::to_vectors() const {
+    std::vector<std::vector<double>> ans;
+    ans.reserve(this->rows);
+
+    for (size_t i = 0; i < this->rows; ++i) {
+        ans.emplace_back(this->row_data(i), this->row_data(i) + this->columns);
+    }
+
+    return ans;
+}
+
+void Matrix::detach() {
+    // A view may cover only a prefix of the storage, the rest belongs to the matrices it was taken from
+    if (this->storage.use_count() == 1) {
+        this->storage->resize(this->rows * this->columns);
+        return;
+    }
+
+    this->storage = std::make_shared<std::vector<double>>(this->data(), this->data() + this->rows * this->columns);
+}
@@ -0,0 +1,118 @@
+#ifndef TREE_MATRIX_H
+#define TREE_MATRIX_H
+
+#include <vector>
+#include <memory>
+#include "Array_view.h"
+
+/// Matrix of doubles stored row by row in one contiguous block (observations and predictions of the regressors)
+///
+/// Copies and views share the storage, it is copied only when a shared matrix is modified. Jagged arrays
+/// convert to and from a matrix implicitly, so code written for std::vector<std::vector<double>> keeps working.
+class Matrix {
+public:
+    Matrix() = default;
+
+    Matrix(
+        size_t rows,       ///< Number of rows
+        size_t columns,    ///< Number of columns
+        double value = 0.0 ///< Value of all elements
+    );
+
+    /// Adapter from a jagged array, all rows must have the same size
+    Matrix(
+        const std::vector<std::vector<double>> &rows ///< Rows of the matrix
+    );
+
+    /// Adapter to a jagged array
+    operator std::vector<std::vector<double>>() const;
+
+    /// Function that returns the number of rows in a matrix
+    size_t get_rows_count() const {
+        return this->rows;
+    }
+
+    /// Function that returns the number of columns in a matrix (the distance between neighbouring rows)
+    size_t get_columns_count() const {
+        return this->columns;
+    }
+
+    /// Function that returns true if the matrix has no rows
+    bool empty() const {
+        return !this->rows;
+    }
+
+    /// Function that returns a pointer to the first element of the first row (rows follow each other)
+    const double* data() const {
+        return this->storage->data();
+    }
+
+    /// Function that returns a pointer to the first element of a row (without bounds checking)
+    const double* row_data(
+        size_t row ///< Row index
+    ) const {
+        return this->storage->data() + row * this->columns;
+    }
+
+    /// Function that returns a pointer to the first element of a row for modification (without bounds checking)
+    double* row_data(
+        size_t row ///< Row index
+    );
+
+    /// Function returning a non-owning contiguous view of a matrix row
+    Array_view row(
+        size_t row ///< Row index
+    ) const;
+
+    /// Function returning a non-owning strided view of a matrix column
+    Array_view column(
+        size_t column ///< Column index
+    ) const;
+
+    /// Function that returns a matrix row by its index
+    std::vector<double> get_row(
+        size_t row ///< Row index
+    ) const;
+
+    /// Function returning a view of the first rows of a matrix without copying data
+    Matrix prefix(
+        size_t rows ///< Number of rows in the view
+    ) const;
+
+    /// Function that inserts a row at the end of a matrix (the first row of an empty matrix sets the columns count)
+    void push_back_row(
+        const std::vector<double> &row ///< New row
+    );
+
+    /// Function that inserts all rows of another matrix at the end of a matrix
+    void append(
+        const Matrix &other ///< Matrix with the same number of columns
+    );
+
+    /// Matrix data access function by row and column indexes
+    double& at(
+        size_t row,   ///< Row index
+        size_t column ///< Column index
+    );
+
+    /// Constant matrix data access function by row and column indexes
+    const double& at(
+        size_t row,   ///< Row index
+        size_t column ///< Column index
+    ) const;
+
+    /// Function that copies the matrix into a jagged array
+    std::vector<std::vector<double>> to_vectors() const;
+
+private:
+    /// Function that makes the matrix the only owner of its storage before modification
+    void detach();
+
+private:
+    size_t rows = 0;    ///< Number of rows in the matrix
+    size_t columns = 0; ///< Number of columns in the matrix
+    std::shared_ptr<std::vector<double>> storage = std::make_shared<std::vector<double>>(); ///< Matrix data stored row by row (shared by views)
+};
+
+
+#endif //TREE_MATRIX_H
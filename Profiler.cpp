@@ -0,0 +1,106 @@
+#include "Profiler.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace {
+    thread_local Profile *target = nullptr; ///< Profile the thread records into
+}
+
+std::atomic<bool> Profiler::enabled(false);
+
+void Profile::merge(const Profile &other) {
+    for (size_t i = 0; i < phases_count; ++i) {
+        this->nanoseconds[i] += other.nanoseconds[i];
+        this->calls[i] += other.calls[i];
+    }
+}
+
+double Profile::get_seconds(Phase phase) const {
+    return static_cast<double>(this->nanoseconds[static_cast<size_t>(phase)]) * 1e-9;
+}
+
+uint64_t Profile::get_calls(Phase phase) const {
+    return this->calls[static_cast<size_t>(phase)];
+}
+
+std::string Profile::to_text() const {
+    std::ostringstream out;
+    out << std::left << std::setw(20) << "phase" << std::right << std::setw(14) << "calls"
+        << std::setw(14) << "seconds" << '\n';
+
+    for (size_t i = 0; i < phases_count; ++i) {
+        if (!this->calls[i]) {
+            continue;
+        }
+
+        const auto phase = static_cast<Phase>(i);
+        out << std::left << std::setw(20) << get_phase_name(phase) << std::right << std::setw(14) << this->calls[i]
+            << std::setw(14) << std::fixed << std::setprecision(6) << this->get_seconds(phase) << '\n';
+    }
+
+    return out.str();
+}
+
+std::string Profile::to_json() const {
+    std::ostringstream out;
+    out << '{';
+
+    for (size_t i = 0; i < phases_count; ++i) {
+        const auto phase = static_cast<Phase>(i);
+        out << (i ? ", " : "") << '"' << get_phase_name(phase) << "\": {\"calls\": " << this->calls[i]
+            << ", \"seconds\": " << std::setprecision(9) << this->get_seconds(phase) << '}';
+    }
+
+    out << '}';
+    return out.str();
+}
+
+std::string Profile::to_json(const std::vector<Profile> &trees) {
+    Profile total;
+    for (const auto &tree : trees) {
+        total.merge(tree);
+    }
+
+    std::ostringstream out;
+    out << "{\"forest\": " << total.to_json() << ", \"trees\": [";
+
+    for (size_t i = 0; i < trees.size(); ++i) {
+        out << (i ? ", " : "") << trees[i].to_json();
+    }
+
+    out << "]}";
+    return out.str();
+}
+
+const char *Profile::get_phase_name(Phase phase) {
+    switch (phase) {
+        case Phase::fit: return "fit";
+        case Phase::bootstrap: return "bootstrap";
+        case Phase::column_extraction: return "column_extraction";
+        case Phase::sorting: return "sorting";
+        case Phase::binning: return "binning";
+        case Phase::histogram: return "histogram";
+        case Phase::node_statistics: return "node_statistics";
+        case Phase::thresholds: return "thresholds";
+        case Phase::split_scan: return "split_scan";
+        case Phase::partition: return "partition";
+        case Phase::node_allocation: return "node_allocation";
+    }
+
+    return "unknown";
+}
+
+void Profiler::set_enabled(bool enabled) {
+    Profiler::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+Profile *Profiler::current() {
+    return target;
+}
+
+Profile *Profiler::attach(Profile *profile) {
+    Profile *previous = target;
+    target = profile;
+    return previous;
+}
@@ -0,0 +1,155 @@
+#ifndef TREE_PROFILER_H
+#define TREE_PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Instrumented phases of training (phases nest inside fit)
+enum class Phase {
+    fit,               ///< Whole model training (recorded by the callers of fit)
+    bootstrap,         ///< Drawing of the bootstrapped samples of forest trees
+    column_extraction, ///< Gathering of the node rows of a feature before sorting
+    sorting,           ///< Sorting of rows by feature values (including presorting)
+    binning,           ///< Quantization of features into histogram bins
+    histogram,         ///< Accumulation and subtraction of bin histograms
+    node_statistics,   ///< Node means, mean square errors and sums of observations
+    thresholds,        ///< Generation of split candidates from distinct feature values
+    split_scan,        ///< Evaluation of split candidates
+    partition,         ///< Partition of node rows between the children
+    node_allocation    ///< Creation of child nodes
+};
+
+/// Time and number of calls of every training phase
+struct Profile {
+    constexpr static size_t phases_count = 11; ///< Number of phases
+
+    std::array<uint64_t, phases_count> nanoseconds{}; ///< Total time of each phase
+    std::array<uint64_t, phases_count> calls{};       ///< Number of measured calls of each phase
+
+    /// Function that adds one measured call of a phase
+    void add(
+        Phase phase,         ///< Phase
+        uint64_t nanoseconds ///< Duration of the call
+    ) {
+        this->nanoseconds[static_cast<size_t>(phase)] += nanoseconds;
+        ++this->calls[static_cast<size_t>(phase)];
+    }
+
+    /// Function that adds the measurements of another profile
+    void merge(
+        const Profile &other ///< Profile to add
+    );
+
+    /// Function that returns the total time of a phase in seconds
+    double get_seconds(
+        Phase phase ///< Phase
+    ) const;
+
+    /// Function that returns the number of measured calls of a phase
+    uint64_t get_calls(
+        Phase phase ///< Phase
+    ) const;
+
+    /// Function that returns the measurements as a text table
+    std::string to_text() const;
+
+    /// Function that returns the measurements as a JSON object
+    std::string to_json() const;
+
+    /// Function that returns the aggregate and per-tree measurements of a forest as a JSON object
+    static std::string to_json(
+        const std::vector<Profile> &trees ///< Profiles of the forest trees
+    );
+
+    /// Function that returns the name of a phase
+    static const char* get_phase_name(
+        Phase phase ///< Phase
+    );
+};
+
+/// Runtime switch of the training instrumentation and the recording target of every thread
+///
+/// Measurements are recorded only while profiling is enabled and only into the profile attached to the
+/// measuring thread, so threads never share a profile and no synchronization is needed.
+class Profiler {
+public:
+    /// Function that turns the instrumentation on or off
+    static void set_enabled(
+        bool enabled ///< New state
+    );
+
+    /// Function that returns true if the instrumentation is on
+    static bool is_enabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /// Function that returns the profile the calling thread records into (nullptr if none)
+    static Profile* current();
+
+    /// Function that changes the profile the calling thread records into, returns the previous one
+    static Profile* attach(
+        Profile *profile ///< New recording target (nullptr - stop recording)
+    );
+
+private:
+    static std::atomic<bool> enabled; ///< Instrumentation state
+};
+
+/// Scope in which the calling thread records into a given profile
+class Profile_scope {
+public:
+    explicit Profile_scope(
+        Profile *profile ///< Recording target (nullptr - no recording in the scope)
+    ) : previous(Profiler::attach(profile)) {}
+
+    ~Profile_scope() {
+        Profiler::attach(this->previous);
+    }
+
+    Profile_scope(const Profile_scope &) = delete;
+    Profile_scope& operator=(const Profile_scope &) = delete;
+
+private:
+    Profile *previous; ///< Recording target before the scope
+};
+
+/// Timer of one call of a phase, the time until stop or the end of the scope is recorded
+class Phase_timer {
+public:
+    explicit Phase_timer(
+        Phase phase ///< Measured phase
+    ) : phase(phase), profile(Profiler::is_enabled() ? Profiler::current() : nullptr) {
+        if (this->profile) {
+            this->start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~Phase_timer() {
+        this->stop();
+    }
+
+    Phase_timer(const Phase_timer &) = delete;
+    Phase_timer& operator=(const Phase_timer &) = delete;
+
+    /// Function that records the call before the end of the scope
+    void stop() {
+        if (this->profile) {
+            const auto duration = std::chrono::steady_clock::now() - this->start;
+            this->profile->add(this->phase, static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+            this->profile = nullptr;
+        }
+    }
+
+private:
+    Phase phase;                                  ///< Measured phase
+    Profile *profile;                             ///< Recording target (nullptr if not recording)
+    std::chrono::steady_clock::time_point start;  ///< Beginning of the call
+};
+
+
+#endif //TREE_PROFILER_H
@@ -3,12 +3,23 @@
 #include <random>
 #include <future>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 #include "omp.h"
 
+
 Random_forest_regressor::Random_forest_regressor(size_t n_trees, double X_features_fraction, double X_obs_fraction,
-                                                 size_t min_samples_split, size_t max_depth) : X_features_fraction(X_features_fraction),
+                                                 size_t min_samples_split, size_t max_depth,
+                                                 Split_method split_method, bool oob_score, uint64_t seed,
+                                                 size_t n_threads, Growth_order growth_order) : X_features_fraction(X_features_fraction),
                                                                                                X_obs_fraction(X_obs_fraction), min_samples_split(min_samples_split),
-                                                                                               max_depth(max_depth), y_shape(0)
+                                                                                               max_depth(max_depth), split_method(split_method), y_shape(0),
+                                                                                               oob_score(oob_score), oob_mae(0), oob_mse(0),
+                                                                                               seed(seed), n_threads(n_threads),
+                                                                                               growth_order(growth_order),
+                                                                                               generator(seed, 2 * n_trees)
 {
     if (this->X_obs_fraction > 1.0 || this->X_obs_fraction < std::numeric_limits<double>::epsilon()) {
         throw std::invalid_argument("X_obs_fraction must be in the interval (0.0, 1.0] ");
@@ -16,108 +27,259 @@ Random_forest_regressor::Random_forest_regressor(size_t n_trees, double X_featur
 
     this->trees.reserve(n_trees);
     for (size_t i = 0; i < n_trees; ++i) {
-        this->trees.emplace_back(this->X_features_fraction, this->min_samples_split, this->max_depth);
+        this->trees.emplace_back(this->X_features_fraction, this->min_samples_split, this->max_depth, split_method,
+                                 Random_generator(seed, i)(), growth_order);
     }
 }
 
-std::pair<Table, std::vector<std::vector<double>>>
-Random_forest_regressor::bootstrap_sample(const Table &x,
-                                          const std::vector<std::vector<double>> &y) const
-{
-    std::pair<Table, std::vector<std::vector<double>>> ans;
+std::unique_ptr<Abstract_regressor> Random_forest_regressor::clone() const {
+    return std::unique_ptr<Abstract_regressor>(new Random_forest_regressor(this->trees.size(), this->X_features_fraction,
+                                                                           this->X_obs_fraction, this->min_samples_split,
+                                                                           this->max_depth, this->split_method,
+                                                                           this->oob_score, this->seed, this->n_threads,
+                                                                           this->growth_order));
+}
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<size_t> distribution(0, y.size() - 1);
+std::vector<size_t> Random_forest_regressor::bootstrap_sample(size_t n_rows, Random_generator &generator) const {
+    std::vector<size_t> ans(n_rows, 0);
 
-    auto n = static_cast<size_t>(static_cast<double>(y.size()) * this->X_obs_fraction);
+    auto n = static_cast<size_t>(static_cast<double>(n_rows) * this->X_obs_fraction);
 
     if (!n) {
         n = 1;
     }
 
-    ans.second.reserve(n);
-    ans.first.set_column_count(x.get_columns_count());
-
-    for (int i = 0; i < n; ++i) {
-        auto index = distribution(gen);
-        ans.second.push_back(y.at(index));
-        ans.first.push_back_row(x.get_row(index));
+    for (size_t i = 0; i < n; ++i) {
+        ++ans[generator.uniform(n_rows)];
     }
 
     return ans;
 }
 
+int Random_forest_regressor::get_threads_count() const {
+    return this->n_threads ? static_cast<int>(this->n_threads) : omp_get_max_threads();
+}
+
 std::vector<double> Random_forest_regressor::predict(const std::vector<double> &values) const {
 
     if (!this->y_shape) {
         return {0};
     }
 
-    std::vector<double> ans(this->y_shape, 0);
-
-    for (const auto &i : this->trees) {
-        auto vec = i.predict(values);
+    return this->compiled.predict(values);
+}
 
-        for (size_t j = 0; j < vec.size(); ++j) {
-            ans[j] += vec[j] / static_cast<double>(this->trees.size());
-        }
+Matrix Random_forest_regressor::predict(const Table &values) const {
+    if (!this->y_shape) {
+        return Matrix(values.get_rows_count(), 1);
     }
 
-    return ans;
+    return this->compiled.predict(values);
 }
 
-std::vector<std::vector<double>> Random_forest_regressor::predict(const Table &values) const {
-    if (!this->y_shape) {
-        return {values.get_rows_count(), std::vector<double>(1, 0)};
+void Random_forest_regressor::print_trees() const {
+    for (auto it = this->trees.cbegin(); it != this->trees.cend(); ++it) {
+        std::cout << "------ \n" << "Tree number: " << it - this->trees.cbegin() + 1 << std::endl;
+        it->print_tree();
+        std::cout << "------ \n";
     }
+}
 
+void Random_forest_regressor::fit(const Table &x, const Matrix &y) {
+    this->y_shape = y.get_columns_count();
+    this->generator = Random_generator(this->seed, 2 * this->trees.size());
 
-    std::vector<std::vector<double>> ans(values.get_rows_count(), std::vector<double>(this->y_shape, 0));
+    // Every tree records into its own profile, the caller's profile receives their sum after the loop
+    const bool profiling = Profiler::is_enabled();
+    Profile *caller_profile = Profiler::current();
+    this->shared_profile = Profile();
+    this->profiles.assign(profiling ? this->trees.size() : 0, Profile());
+
+    // Histogram bins are shared by all trees, bootstrapped samples are row weights over the shared data
+    Binned_features bins;
+    if (this->split_method == Split_method::histogram) {
+        Profile_scope scope(profiling ? &this->shared_profile : nullptr);
+        bins.build(x);
+    }
 
-    std::vector<std::vector<std::vector<double>>> partial_sums(omp_get_max_threads(),
-                                                           std::vector<std::vector<double>>(values.get_rows_count(),
-                                                                   std::vector<double>(this->y_shape, 0)));
+    // Every tree draws its sample from its own stream, so the forest does not depend on thread scheduling.
+    // Trees are tasks of one team and spawn their node tasks into it, threads left without a tree of their own
+    // take the nodes of the trees still growing
+    const auto n_trees = static_cast<long long>(this->trees.size());
+    const int threads = this->get_threads_count();
 
-#pragma omp parallel for default(none) shared(values, ans, partial_sums)
+#pragma omp parallel num_threads(threads) shared(x, y, bins, n_trees, profiling) default(none)
+#pragma omp single
+    for (long long i = 0; i < n_trees; ++i) {
+#pragma omp task firstprivate(i) shared(x, y, bins, profiling) default(none)
+        {
+            Profile_scope scope(profiling ? &this->profiles[i] : nullptr);
+
+            Phase_timer timer(Phase::bootstrap);
+            Random_generator stream(this->seed, this->trees.size() + i);
+            const std::vector<size_t> weights = bootstrap_sample(y.get_rows_count(), stream);
+            timer.stop();
+
+            if (this->split_method == Split_method::histogram) {
+                this->trees[i].fit(bins, y, weights);
+            }
+            else {
+                this->trees[i].fit(x, y, weights);
+            }
+        }
+    }
+
+    if (profiling && caller_profile) {
+        caller_profile->merge(this->get_profile());
+    }
+
+    this->compiled = Compiled_forest();
     for (const auto &i : this->trees) {
-        auto vec = i.predict(values);
+        this->compiled.append(i.compile());
+    }
 
-        int thread_id = omp_get_thread_num();
-            for (size_t j = 0; j < vec.size(); ++j) {
-                for (size_t k = 0; k < vec[j].size(); ++k) {
-                    partial_sums[thread_id][j][k] += vec[j][k] / static_cast<double>(this->trees.size());
+    if (this->oob_score) {
+        this->compute_oob(x, y);
+    }
+}
+
+void Random_forest_regressor::compute_oob(const Table &x, const Matrix &y) {
+    const size_t n_rows = y.get_rows_count();
+    const auto rows = static_cast<long long>(n_rows);
+    const int threads = this->get_threads_count();
+    std::vector<size_t> counts(n_rows, 0);
+    this->oob_predictions = Matrix(n_rows, this->y_shape);
+    double *predictions = this->oob_predictions.row_data(0);
+
+    // Trees are visited in order and the rows are split between threads, so the sums do not depend on scheduling.
+    // The bootstrapped samples are drawn again from the tree streams instead of being kept since fit
+    for (size_t i = 0; i < this->trees.size(); ++i) {
+        Random_generator stream(this->seed, this->trees.size() + i);
+        const std::vector<size_t> weights = bootstrap_sample(n_rows, stream);
+
+#pragma omp parallel for num_threads(threads) shared(x, weights, counts, rows, i, predictions) default(none)
+        for (long long row = 0; row < rows; ++row) {
+            if (!weights[row]) {
+                const double *leaf = this->compiled.predict_tree(i, x.row(row));
+                double *prediction = predictions + row * this->y_shape;
+
+                for (size_t j = 0; j < this->y_shape; ++j) {
+                    prediction[j] += leaf[j];
                 }
+                ++counts[row];
             }
+        }
     }
 
-    for (auto &sum : partial_sums) {
-        for (size_t j = 0; j < sum.size(); ++j) {
-            for (size_t k = 0; k < sum[j].size(); ++k) {
-                ans[j][k] += sum[j][k];
-            }
+    size_t n_oob = 0;
+    long double abs_sum = 0, square_sum = 0;
+
+    for (size_t row = 0; row < n_rows; ++row) {
+        double *prediction = predictions + row * this->y_shape;
+        const double *observation = y.row_data(row);
+
+        if (!counts[row]) {
+            std::fill(prediction, prediction + this->y_shape, std::numeric_limits<double>::quiet_NaN());
+            continue;
         }
+
+        for (size_t j = 0; j < this->y_shape; ++j) {
+            prediction[j] /= static_cast<double>(counts[row]);
+            const double error = prediction[j] - observation[j];
+            abs_sum += std::abs(error);
+            square_sum += error * error;
+        }
+        ++n_oob;
     }
 
-    return ans;
+    const auto n = static_cast<long double>(n_oob * this->y_shape);
+    this->oob_mae = n_oob ? static_cast<double>(abs_sum / n) : std::numeric_limits<double>::quiet_NaN();
+    this->oob_mse = n_oob ? static_cast<double>(square_sum / n) : std::numeric_limits<double>::quiet_NaN();
 }
 
-void Random_forest_regressor::print_trees() const {
-    for (auto it = this->trees.cbegin(); it != this->trees.cend(); ++it) {
-        std::cout << "------ \n" << "Tree number: " << it - this->trees.cbegin() + 1 << std::endl;
-        it->print_tree();
-        std::cout << "------ \n";
+void Random_forest_regressor::partial_fit(const std::vector<double> &row, const std::vector<double> &y) {
+    if (this->y_shape && y.size() != this->y_shape) {
+        throw std::invalid_argument("Wrong number of observations");
+    }
+
+    if (row.size() < this->compiled.get_features_count()) {
+        throw std::out_of_range("Out of range");
+    }
+
+    // Online bagging: every tree sees the observation a Poisson distributed number of times,
+    // the first observation of an untrained forest is given to all trees so that none stays empty
+    std::poisson_distribution<size_t> distribution(this->X_obs_fraction);
+
+    const bool first = !this->y_shape;
+    this->y_shape = y.size();
+
+    std::vector<size_t> weights(this->trees.size());
+    for (auto &weight : weights) {
+        weight = std::max<size_t>(distribution(this->generator), first ? 1 : 0);
+    }
+
+    const auto n_trees = static_cast<long long>(this->trees.size());
+    const int threads = this->get_threads_count();
+    std::vector<char> resplit(this->trees.size(), 0);
+
+#pragma omp parallel for num_threads(threads) shared(row, y, weights, resplit, n_trees) default(none)
+    for (long long i = 0; i < n_trees; ++i) {
+        if (weights[i]) {
+            resplit[i] = this->trees[i].partial_fit(row, y, weights[i]);
+        }
+    }
+
+    if (first || std::find(resplit.begin(), resplit.end(), 1) != resplit.end()) {
+        this->compiled = Compiled_forest();
+        for (const auto &i : this->trees) {
+            this->compiled.append(i.compile());
+        }
+        return;
+    }
+
+    const Array_view values(row.data(), row.size());
+    for (size_t i = 0; i < this->trees.size(); ++i) {
+        if (weights[i]) {
+            this->compiled.set_leaf_values(i, values, this->trees[i].predict(row));
+        }
     }
 }
 
-void Random_forest_regressor::fit(const Table &x,
-                                  const std::vector<std::vector<double>> &y)
-{
-    this->y_shape = y.front().size();
+void Random_forest_regressor::save(const std::string &file_name) const {
+    this->compiled.save(file_name);
+}
+
+const Compiled_forest &Random_forest_regressor::get_compiled() const {
+    return this->compiled;
+}
+
+const std::vector<Profile> &Random_forest_regressor::get_tree_profiles() const {
+    return this->profiles;
+}
 
-#pragma omp parallel for shared(x, y) default(none)
-    for (auto &i : this->trees) {
-        auto new_data = bootstrap_sample(x, y);
-        i.fit(new_data.first, new_data.second);
+Profile Random_forest_regressor::get_profile() const {
+    Profile ans = this->shared_profile;
+    for (const auto &profile : this->profiles) {
+        ans.merge(profile);
     }
+
+    return ans;
+}
+
+const Matrix &Random_forest_regressor::get_oob_predictions() const {
+    if (!this->oob_score || this->oob_predictions.empty()) {
+        throw std::logic_error("Out-of-bag estimate is not available (oob_score is off or the forest is not fitted)");
+    }
+
+    return this->oob_predictions;
+}
+
+double Random_forest_regressor::get_oob_mae() const {
+    this->get_oob_predictions();
+    return this->oob_mae;
+}
+
+double Random_forest_regressor::get_oob_mse() const {
+    this->get_oob_predictions();
+    return this->oob_mse;
 }
@@ -4,8 +4,10 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <random>
 #include "Random_forest_tree.h"
 #include "Abstract_regressor.h"
+#include "Profiler.h"
 
 
 class Random_forest_regressor : public Abstract_regressor{
@@ -15,13 +17,30 @@ public:
         double X_features_fraction = 1.0, ///< Proportion of features used (Accepts values from 0.0 to 1.0)
         double X_obs_fraction = 1.0,      ///< Proportion of rows used from the training set (Accepts values from 0.0 to 1.0)
         size_t min_samples_split = 20,    ///< Minimum sample size that can be at the tree node
-        size_t max_depth = 5              ///< Maximum tree depth
+        size_t max_depth = 5,             ///< Maximum tree depth
+        Split_method split_method = Split_method::exact, ///< Method of searching for the best split in tree nodes
+        bool oob_score = false,                          ///< Estimate the out-of-bag error during fit
+        uint64_t seed = std::random_device()(),          ///< Master seed of the random streams (random by default)
+        size_t n_threads = 0,                            ///< Number of threads training the forest (0 - OpenMP default)
+        Growth_order growth_order = Growth_order::depth_first ///< Order of growing the tree nodes
     );
 
+    /// Function that creates an untrained regressor with the same parameters
+    std::unique_ptr<Abstract_regressor> clone() const override;
+
     /// Model training function
     void fit(
-        const Table &x,                           ///< Feature set
-        const std::vector<std::vector<double>> &y ///< Feature-related observations
+        const Table &x, ///< Feature set
+        const Matrix &y ///< Feature-related observations
+    ) override;
+
+    /// Function that updates the trained forest with one new observation (online bagging)
+    ///
+    /// Each tree receives the observation a Poisson distributed number of times (with mean X_obs_fraction),
+    /// the flat inference representation is rebuilt only if the structure of some tree changed.
+    void partial_fit(
+        const std::vector<double> &row, ///< One feature set
+        const std::vector<double> &y    ///< Feature-related observation
     ) override;
 
     /// Prediction function for one set of features
@@ -30,28 +49,74 @@ public:
     ) const override;
 
     /// Prediction function for multiple feature sets
-    std::vector<std::vector<double>> predict(
+    Matrix predict(
         const Table &values ///< Multiple feature sets
     ) const override;
 
     /// Function to display information about all trees
     void print_trees() const;
 
+    /// Function that writes the trained forest to a binary model file (see Compiled_forest::load)
+    void save(
+        const std::string &file_name ///< The path to the file
+    ) const;
+
+    /// Function that returns the flat inference representation of all trees
+    const Compiled_forest& get_compiled() const;
+
+    /// Function that returns the training phase measurements of every tree of the last fit
+    /// (empty if the fit ran with the profiler disabled, see Profiler::set_enabled)
+    const std::vector<Profile>& get_tree_profiles() const;
+
+    /// Function that returns the training phase measurements of the last fit (all trees and the shared steps)
+    Profile get_profile() const;
+
+    /// Function that returns the out-of-bag prediction of every training row of the last fit
+    ///
+    /// A row is predicted by the trees whose bootstrapped sample left it out, rows drawn by every tree are NaN.
+    const Matrix& get_oob_predictions() const;
+
+    /// Function that returns the mean absolute error of the out-of-bag predictions of the last fit
+    double get_oob_mae() const;
+
+    /// Function that returns the mean square error of the out-of-bag predictions of the last fit
+    double get_oob_mse() const;
+
 private:
-    /// Function that creates a bootstrapped sample
-    std::pair<Table, std::vector<std::vector<double>>>
-            bootstrap_sample(
-                const Table &x,                           ///< Feature set
-                const std::vector<std::vector<double>> &y ///< Feature-related observations
-            ) const;
+    /// Function that returns the number of threads of the training loops
+    int get_threads_count() const;
+
+    /// Function that draws a bootstrapped sample as the number of times every row was drawn
+    std::vector<size_t> bootstrap_sample(
+        size_t n_rows,              ///< Number of rows of the training set
+        Random_generator &generator ///< Random stream of the tree
+    ) const;
+
+    /// Function that accumulates the predictions of every tree for the rows left out of its sample
+    void compute_oob(
+        const Table &x, ///< Feature set
+        const Matrix &y ///< Feature-related observations
+    );
 
 private:
     size_t min_samples_split;              ///< Minimum sample size that can be at the tree node
     size_t max_depth;                      ///< Maximum tree depth
+    Split_method split_method;             ///< Method of searching for the best split in tree nodes
     size_t y_shape;                        ///< Number of observations
     std::vector<Random_forest_tree> trees; ///< Array of trees
+    Compiled_forest compiled;              ///< Flat inference representation of all trees
     double X_features_fraction;            ///< Proportion of features used (Accepts values from 0.0 to 1.0)
     double X_obs_fraction;                 ///< Proportion of rows used from the training set (Accepts values from 0.0 to 1.0)
+    std::vector<Profile> profiles;         ///< Training phase measurements of every tree of the last fit
+    Profile shared_profile;                ///< Training phase measurements of the steps shared by all trees
+    bool oob_score;                        ///< Estimate the out-of-bag error during fit
+    Matrix oob_predictions;                ///< Out-of-bag prediction of every training row
+    double oob_mae;                        ///< Mean absolute error of the out-of-bag predictions
+    double oob_mse;                        ///< Mean square error of the out-of-bag predictions
+    uint64_t seed;                         ///< Master seed (stream i seeds tree i, stream n_trees + i its bootstrap)
+    size_t n_threads;                      ///< Number of threads training the forest (0 - OpenMP default)
+    Growth_order growth_order;             ///< Order of growing the tree nodes
+    Random_generator generator;            ///< Online bagging stream (used by partial_fit)
 };
 
 
@@ -0,0 +1,86 @@
+#ifndef TREE_RANDOM_GENERATOR_H
+#define TREE_RANDOM_GENERATOR_H
+
+#include <cstdint>
+#include <cstddef>
+
+/// Xoshiro256** pseudo-random number generator
+///
+/// The state is seeded by SplitMix64, generators of different streams derived from one master seed are
+/// independent, so every tree of a forest gets its own reproducible sequence regardless of thread scheduling.
+/// Satisfies the UniformRandomBitGenerator requirements of the standard distributions.
+class Random_generator {
+public:
+    typedef uint64_t result_type;
+
+    explicit Random_generator(
+        uint64_t seed = 0,  ///< Master seed
+        uint64_t stream = 0 ///< Index of the stream derived from the master seed
+    ) {
+        uint64_t x = seed;
+        x = split_mix(x) ^ mix(stream + 0x9E3779B97F4A7C15ULL);
+
+        for (auto &word : this->state) {
+            word = split_mix(x);
+        }
+    }
+
+    static constexpr result_type min() {
+        return 0;
+    }
+
+    static constexpr result_type max() {
+        return UINT64_MAX;
+    }
+
+    /// Function that returns the next 64 random bits
+    result_type operator()() {
+        const uint64_t ans = rotl(this->state[1] * 5, 7) * 9;
+        const uint64_t t = this->state[1] << 17;
+
+        this->state[2] ^= this->state[0];
+        this->state[3] ^= this->state[1];
+        this->state[1] ^= this->state[2];
+        this->state[0] ^= this->state[3];
+        this->state[2] ^= t;
+        this->state[3] = rotl(this->state[3], 45);
+
+        return ans;
+    }
+
+    /// Function that returns an unbiased random integer in the interval [0, n)
+    size_t uniform(
+        size_t n ///< Number of possible values (greater than 0)
+    ) {
+        const uint64_t threshold = (0 - static_cast<uint64_t>(n)) % n;
+        uint64_t x = (*this)();
+
+        while (x < threshold) {
+            x = (*this)();
+        }
+
+        return static_cast<size_t>(x % n);
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    static uint64_t split_mix(uint64_t &x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        return mix(x);
+    }
+
+private:
+    uint64_t state[4]; ///< Generator state
+};
+
+
+#endif //TREE_RANDOM_GENERATOR_H
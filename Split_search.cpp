@@ -0,0 +1,106 @@
+#include "Split_search.h"
+
+#include <algorithm>
+#include <numeric>
+#include "Profiler.h"
+
+// Clones are dispatched through ifunc, which needs an ELF target with the GNU C library
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && defined(__ELF__) && defined(__GLIBC__)
+#define TREE_SPLIT_KERNEL_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define TREE_SPLIT_KERNEL_CLONES
+#endif
+
+namespace {
+    /// Function that adds the left and right child errors of one output to the errors of all candidates
+    TREE_SPLIT_KERNEL_CLONES
+    void add_mse_errors(const double *left_rows, const double *left_sum, const double *left_sum2, size_t count,
+                        double rows, double sum, double sum2, double *errors)
+    {
+#pragma omp simd
+        for (size_t k = 0; k < count; ++k) {
+            const double right_sum = sum - left_sum[k];
+            errors[k] += (left_sum2[k] - left_sum[k] * left_sum[k] / left_rows[k]) +
+                         ((sum2 - left_sum2[k]) - right_sum * right_sum / (rows - left_rows[k]));
+        }
+    }
+}
+
+void Mse_criterion::split_errors(Split_candidates &candidates) {
+    const size_t m = candidates.count;
+    candidates.error.resize(m);
+    std::fill(candidates.error.begin(), candidates.error.begin() + m, 0.0);
+
+    for (size_t j = 0; j < candidates.outputs; ++j) {
+        add_mse_errors(candidates.left_rows.data(), candidates.left_sum.data() + j * m,
+                       candidates.left_sum2.data() + j * m, m, candidates.rows, candidates.sum[j], candidates.sum2[j],
+                       candidates.error.data());
+    }
+
+    for (size_t k = 0; k < m; ++k) {
+        candidates.error[k] /= candidates.n;
+    }
+}
+
+void Presorted_features::build(const Table &x) {
+    Phase_timer timer(Phase::sorting);
+    this->orders.assign(x.get_columns_count(), std::vector<int>(x.get_rows_count()));
+
+    for (size_t feature = 0; feature < this->orders.size(); ++feature) {
+        const Array_view arr = x.column(feature);
+        std::vector<int> &order = this->orders[feature];
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&arr](int a, int b){return arr[a] < arr[b];});
+    }
+}
+
+void Presorted_features::build(const Table &x, const std::vector<int> &rows) {
+    Phase_timer timer(Phase::sorting);
+    this->orders.assign(x.get_columns_count(), rows);
+
+    for (size_t feature = 0; feature < this->orders.size(); ++feature) {
+        const Array_view arr = x.column(feature);
+        std::vector<int> &order = this->orders[feature];
+        std::sort(order.begin(), order.end(), [&arr](int a, int b){return arr[a] < arr[b];});
+    }
+}
+
+const int *Presorted_features::order(size_t feature, size_t begin) const {
+    return this->orders[feature].data() + begin;
+}
+
+size_t Presorted_features::partition(size_t begin, size_t end, const std::vector<char> &goes_right) {
+    Phase_timer timer(Phase::partition);
+    std::vector<int> right;
+    right.reserve(end - begin);
+    size_t mid = begin;
+
+    for (auto &order : this->orders) {
+        right.clear();
+        mid = begin;
+
+        for (size_t i = begin; i < end; ++i) {
+            if (goes_right[order[i]]) {
+                right.push_back(order[i]);
+            }
+            else {
+                order[mid++] = order[i];
+            }
+        }
+
+        std::copy(right.begin(), right.end(), order.begin() + mid);
+    }
+
+    return mid;
+}
+
+std::vector<int> get_weighted_rows(const std::vector<size_t> &weights) {
+    std::vector<int> ans;
+    ans.reserve(std::accumulate(weights.begin(), weights.end(), size_t(0)));
+
+    for (size_t i = 0; i < weights.size(); ++i) {
+        ans.insert(ans.end(), weights[i], static_cast<int>(i));
+    }
+
+    return ans;
+}
@@ -0,0 +1,340 @@
+#ifndef TREE_SPLIT_SEARCH_H
+#define TREE_SPLIT_SEARCH_H
+
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <utility>
+#include "Table.h"
+#include "Matrix.h"
+#include "Profiler.h"
+
+/// Method of searching for the best split in tree nodes
+enum class Split_method {
+    exact,     ///< Feature values are sorted anew in every node
+    presorted, ///< Feature values are sorted once per fit and sorted index lists are partitioned down the tree
+    histogram  ///< Feature values are quantized into at most 256 bins once per fit, nodes scan bin histograms
+};
+
+/// Sums of node observations normalized by the mean square error denominator
+template <typename Accumulator>
+struct Basic_target_sums {
+    std::vector<Accumulator> sum;  ///< Normalized sum of observations for each output
+    std::vector<Accumulator> sum2; ///< Normalized sum of squared observations for each output
+    Accumulator n = 0;             ///< Mean square error denominator (samples count times outputs count)
+};
+
+typedef Basic_target_sums<long double> Target_sums;
+
+/// Threshold policy: split candidates are moving averages of Window consecutive distinct feature values
+template <int Window>
+struct Moving_average_thresholds {
+    constexpr static int window = Window; ///< Window size (minimum number of rows a node needs to be split)
+
+    /// Function that returns the candidate ending at the k-th distinct value (k >= window - 1)
+    static double get(
+        const std::vector<double> &distinct, ///< Distinct feature values in ascending order
+        size_t k                             ///< Index of the last value of the window
+    ) {
+        double value = 0;
+        for (int j = 0; j < Window; ++j) {
+            value += distinct[k - j] / Window;
+        }
+
+        return value;
+    }
+};
+
+/// Split candidates of one feature with the observation sums of the rows left of each of them
+///
+/// The sums are taken over observations centered by the node mean and are stored output by output
+/// (the sums of output j for all candidates are contiguous), so that a criterion scores all candidates in one pass.
+/// The buffers keep their memory and are reused for all features of a node.
+struct Split_candidates {
+    size_t count = 0;              ///< Number of candidates
+    size_t outputs = 0;            ///< Number of outputs
+    double rows = 0;               ///< Number of node rows
+    double n = 0;                  ///< Mean square error denominator of the node
+    std::vector<double> distinct;  ///< Distinct feature values in ascending order
+    std::vector<double> value;     ///< Threshold of every candidate
+    std::vector<double> left_rows; ///< Number of rows left of every candidate
+    std::vector<double> left_sum;  ///< Sum of the left observations (count values per output)
+    std::vector<double> left_sum2; ///< Sum of the squared left observations (count values per output)
+    std::vector<double> sum;       ///< Sum of all node observations for each output
+    std::vector<double> sum2;      ///< Sum of all squared node observations for each output
+    std::vector<double> error;     ///< Split error of every candidate (filled by the criterion)
+};
+
+/// Split criterion: sum of the mean square errors of the children
+struct Mse_criterion {
+    /// Function that computes the split error of every candidate (vectorized for the widest instruction set available)
+    static void split_errors(
+        Split_candidates &candidates ///< Candidates of one feature
+    );
+};
+
+/// Function that adds a value to a compensated sum (TwoSum: the rounding error of every addition is accumulated apart)
+inline void compensated_add(
+    double &sum,          ///< Rounded sum
+    double &compensation, ///< Accumulated rounding error of the sum
+    double value          ///< Added value
+) {
+    const double total = sum + value;
+    const double part = total - sum;
+    compensation += (sum - (total - part)) + (value - part);
+    sum = total;
+}
+
+/// Per-output values with the number of outputs fixed at compile time, kept in registers rather than on the heap
+template <typename T, size_t N_OUT>
+class Output_values {
+public:
+    explicit Output_values(
+        const std::vector<T> &values ///< Initial values (at least N_OUT)
+    ) {
+        std::copy(values.begin(), values.begin() + N_OUT, this->values.begin());
+    }
+
+    /// Function that returns the number of outputs
+    constexpr size_t size() const {
+        return N_OUT;
+    }
+
+    T& operator[](size_t i) {
+        return this->values[i];
+    }
+
+private:
+    std::array<T, N_OUT> values; ///< Values of the outputs
+};
+
+/// Per-output values with the number of outputs known only at runtime
+template <typename T>
+class Output_values<T, 0> {
+public:
+    explicit Output_values(
+        const std::vector<T> &values ///< Initial values
+    ) : values(values) {}
+
+    /// Function that returns the number of outputs
+    size_t size() const {
+        return this->values.size();
+    }
+
+    T& operator[](size_t i) {
+        return this->values[i];
+    }
+
+private:
+    std::vector<T> values; ///< Values of the outputs
+};
+
+/// Row indices of a table sorted by every feature, partitioned between tree nodes (SLIQ/SPRINT style)
+class Presorted_features {
+public:
+    /// Function that sorts the table rows by each feature
+    void build(
+        const Table &x ///< Feature set
+    );
+
+    /// Function that sorts the selected table rows by each feature (indices may repeat)
+    void build(
+        const Table &x,              ///< Feature set
+        const std::vector<int> &rows ///< Selected row indices
+    );
+
+    /// Function that returns the node rows sorted by feature value
+    const int* order(
+        size_t feature, ///< Feature index
+        size_t begin    ///< Beginning of the node range
+    ) const;
+
+    /// Function that stably moves the node rows going to the right child after the rest in every feature list
+    size_t partition(
+        size_t begin,                       ///< Beginning of the node range
+        size_t end,                         ///< End of the node range
+        const std::vector<char> &goes_right ///< Row flags (non-zero if the row goes to the right child)
+    );
+
+private:
+    std::vector<std::vector<int>> orders; ///< Row indices sorted by value for each feature
+};
+
+/// Function that lists row indices in ascending order, each repeated as many times as its weight
+std::vector<int> get_weighted_rows(
+    const std::vector<size_t> &weights ///< Integer weight (multiplicity) of every row
+);
+
+// Node statistics and the split scan are templates over the number of outputs N_OUT (0 - known only at
+// runtime): with a fixed number the loops over the outputs are unrolled and the sums stay in registers.
+
+/// Function of obtaining the average for each column of the selected matrix rows
+template <size_t N_OUT = 0>
+std::vector<double> get_rows_mean(
+    const Matrix &arr, ///< Matrix
+    const int *rows,   ///< Selected row indices
+    size_t count       ///< Number of selected rows
+) {
+    Phase_timer timer(Phase::node_statistics);
+    const size_t outputs = N_OUT ? N_OUT : arr.get_columns_count();
+    const double *data = arr.data();
+    std::vector<double> ans(outputs, 0);
+
+    for (size_t i = 0; i < count; ++i) {
+        const double *row = data + rows[i] * outputs;
+        for (size_t j = 0; j < outputs; ++j) {
+            ans[j] += row[j] / static_cast<double>(count);
+        }
+    }
+
+    return ans;
+}
+
+/// Mean square error calculation function for the selected matrix rows
+template <size_t N_OUT = 0, typename Accumulator = long double>
+Accumulator get_rows_mse(
+    const Matrix &arr,                ///< Actual value matrix
+    const int *rows,                  ///< Selected row indices
+    size_t count,                     ///< Number of selected rows
+    const std::vector<double> &value, ///< Estimated values array
+    double n                          ///< Mean square error denominator
+) {
+    Phase_timer timer(Phase::node_statistics);
+    const size_t outputs = N_OUT ? N_OUT : arr.get_columns_count();
+    const double *data = arr.data();
+    Accumulator ans = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const double *row = data + rows[i] * outputs;
+        for (size_t j = 0; j < outputs; ++j) {
+            ans += (row[j] / n) * row[j] - 2 * (row[j] / n) * value[j] + (value[j] / n) * value[j];
+        }
+    }
+
+    return ans;
+}
+
+/// Function of calculating the sums of the selected observations required for split search
+template <size_t N_OUT = 0, typename Accumulator = long double>
+Basic_target_sums<Accumulator> get_target_sums(
+    const Matrix &y, ///< Feature-related observations
+    const int *rows, ///< Selected row indices
+    size_t count     ///< Number of selected rows
+) {
+    Phase_timer timer(Phase::node_statistics);
+    Basic_target_sums<Accumulator> ans;
+    const size_t outputs = N_OUT ? N_OUT : y.get_columns_count();
+    const double *data = y.data();
+    ans.n = static_cast<Accumulator>(count * outputs);
+    ans.sum.assign(outputs, 0);
+    ans.sum2.assign(outputs, 0);
+
+    for (size_t i = 0; i < count; ++i) {
+        const double *row = data + rows[i] * outputs;
+        for (size_t j = 0; j < outputs; ++j) {
+            ans.sum[j] += row[j] / ans.n;
+            ans.sum2[j] += row[j] / ans.n * row[j];
+        }
+    }
+
+    return ans;
+}
+
+/// Function of searching for the best split value of one feature over rows sorted by this feature
+///
+/// Observations are centered by the node mean and summed in double precision with compensation in one sequential
+/// pass over the rows, recording the prefix sums at every candidate. The criterion then scores all candidates at once.
+template <typename Thresholds, typename Criterion = Mse_criterion, size_t N_OUT = 0, typename Accumulator>
+void scan_feature(
+    const Array_view &arr,                      ///< Feature values
+    const int *order,                           ///< Row indices sorted in non-descending order of arr
+    size_t count,                               ///< Number of rows
+    const Matrix &y,                            ///< Feature-related observations
+    const Basic_target_sums<Accumulator> &sums, ///< Sums of the observations of these rows
+    int feature,                                ///< Feature index reported in the result
+    Accumulator &mse_base,                      ///< Best split error found so far
+    std::pair<int, double> &ans,                ///< Best feature and value found so far
+    Split_candidates &candidates                ///< Buffers reused between the features of a node
+) {
+    Phase_timer thresholds(Phase::thresholds);
+    std::vector<double> &distinct = candidates.distinct;
+    distinct.clear();
+    for (size_t i = 0; i < count; ++i) {
+        if (distinct.empty() || distinct.back() != arr[order[i]]) {
+            distinct.push_back(arr[order[i]]);
+        }
+    }
+
+    const size_t first = Thresholds::window - 1;
+    if (distinct.size() <= first) {
+        return;
+    }
+
+    candidates.count = distinct.size() - first;
+    candidates.value.resize(candidates.count);
+    for (size_t k = 0; k < candidates.count; ++k) {
+        candidates.value[k] = Thresholds::get(distinct, first + k);
+    }
+    thresholds.stop();
+
+    Phase_timer timer(Phase::split_scan);
+    const size_t outputs = N_OUT ? N_OUT : y.get_columns_count();
+    const size_t m = candidates.count;
+    const double *data = y.data();
+    candidates.outputs = outputs;
+    candidates.rows = static_cast<double>(count);
+    candidates.n = static_cast<double>(sums.n);
+    candidates.left_rows.resize(m);
+    candidates.left_sum.resize(m * outputs);
+    candidates.left_sum2.resize(m * outputs);
+
+    std::vector<double> zero(outputs, 0), centre(outputs);
+    for (size_t j = 0; j < outputs; ++j) {
+        centre[j] = static_cast<double>(sums.sum[j] * sums.n / static_cast<Accumulator>(count));
+    }
+    Output_values<double, N_OUT> mean(centre), sum(zero), sum2(zero), error(zero), error2(zero);
+
+    size_t NLeft = 0;
+    const auto add_row = [&](int row) {
+        const double *values = data + row * outputs;
+        for (size_t j = 0; j < mean.size(); ++j) {
+            const double value = values[j] - mean[j];
+            compensated_add(sum[j], error[j], value);
+            compensated_add(sum2[j], error2[j], value * value);
+        }
+    };
+
+    for (size_t k = 0; k < m; ++k) {
+        while (NLeft < count - 1 && arr[order[NLeft]] < candidates.value[k]) {
+            add_row(order[NLeft++]);
+        }
+
+        candidates.left_rows[k] = static_cast<double>(NLeft);
+        for (size_t j = 0; j < mean.size(); ++j) {
+            candidates.left_sum[j * m + k] = sum[j] + error[j];
+            candidates.left_sum2[j * m + k] = sum2[j] + error2[j];
+        }
+    }
+
+    for (; NLeft < count; ++NLeft) {
+        add_row(order[NLeft]);
+    }
+
+    candidates.sum.resize(outputs);
+    candidates.sum2.resize(outputs);
+    for (size_t j = 0; j < mean.size(); ++j) {
+        candidates.sum[j] = sum[j] + error[j];
+        candidates.sum2[j] = sum2[j] + error2[j];
+    }
+
+    Criterion::split_errors(candidates);
+    for (size_t k = 0; k < m; ++k) {
+        if (candidates.error[k] < mse_base) {
+            ans.first = feature;
+            ans.second = candidates.value[k];
+            mse_base = candidates.error[k];
+        }
+    }
+}
+
+#endif //TREE_SPLIT_SEARCH_H
@@ -1,48 +1,120 @@
 #include "Table.h"
 
-#include <fstream>
-#include <sstream>
+#include <ostream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "omp.h"
+#include "Csv_parser.h"
+#include "Mapped_file.h"
+
+namespace {
+    constexpr size_t min_chunk_bytes = 1 << 16; ///< Smallest part of a file parsed by one task
+
+    /// Function that returns the end of the line starting at begin
+    const char *line_end(const char *begin, const char *end) {
+        const auto *ans = static_cast<const char *>(std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+        return ans ? ans : end;
+    }
 
-void Table::load_from_file(const std::string &file_name, const std::unordered_set<std::string> &ignored_columns, char delim) {
-    std::ifstream inp(file_name);
+    bool is_blank(const char *begin, const char *end) {
+        for (; begin != end; ++begin) {
+            if (*begin != ' ' && *begin != '\t' && *begin != '\r') {
+                return false;
+            }
+        }
 
-    if (!inp.is_open()) {
-        throw std::invalid_argument("Failed to open file");
+        return true;
     }
+}
 
-    std::string line;
-    std::getline(inp, line);
+void Table::load_from_file(const std::string &file_name, const std::unordered_set<std::string> &ignored_columns, char delim) {
+    const Mapped_file file(file_name);
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+
+    const char *header_end = line_end(begin, end);
+
+    // Ignored columns are resolved once, lines are then parsed by position
+    const std::vector<char> keep = parse_csv_header(std::string(begin, header_end), delim, ignored_columns);
+    const auto columns = static_cast<size_t>(std::count(keep.begin(), keep.end(), 1));
+
+    // The body is split into chunks starting at line beginnings, every chunk is parsed by one task
+    const char *body = header_end == end ? end : header_end + 1;
+    const auto body_size = static_cast<size_t>(end - body);
+    const size_t n_chunks = std::max<size_t>(1, std::min<size_t>(4 * static_cast<size_t>(omp_get_max_threads()),
+                                                                 body_size / min_chunk_bytes));
+
+    std::vector<const char *> bounds(n_chunks + 1, end);
+    bounds[0] = body;
+    for (size_t k = 1; k < n_chunks; ++k) {
+        const char *guess = std::max(body + body_size / n_chunks * k, bounds[k - 1]);
+        const char *line = line_end(guess, end);
+        bounds[k] = line == end ? end : line + 1;
+    }
 
-    std::vector<std::string> column_names = split(line, delim);
-    this->columns = column_names.size();
+    std::vector<size_t> first_row(n_chunks + 1, 0);
 
-    if (ignored_columns.size() >= this->columns) {
-        throw std::invalid_argument("The number of columns to be ignored is greater or equal than the total number of columns");
+#pragma omp parallel for schedule(dynamic) default(none) shared(bounds, first_row, n_chunks, end)
+    for (long long k = 0; k < static_cast<long long>(n_chunks); ++k) {
+        size_t count = 0;
+        for (const char *line = bounds[k]; line < bounds[k + 1];) {
+            const char *next = line_end(line, end);
+            count += !is_blank(line, next);
+            line = next == end ? end : next + 1;
+        }
+        first_row[k + 1] = count;
     }
 
-    this->columns -= ignored_columns.size();
+    for (size_t k = 0; k < n_chunks; ++k) {
+        first_row[k + 1] += first_row[k];
+    }
 
-    while (std::getline(inp, line)) {
-        ++this->rows;
-        std::vector<std::string> temp = split(line, delim);
-        for (size_t i = 0; i < temp.size(); ++i) {
-            if (ignored_columns.find(column_names[i]) != ignored_columns.end()) {
-                continue;
+    this->rows = 0;
+    this->pitch = 0;
+    this->columns = columns;
+    this->data = std::make_shared<Storage>();
+    this->reserve_rows(first_row.back());
+    this->rows = first_row.back();
+
+    double *values = this->data->data();
+    const size_t pitch = this->pitch;
+    std::vector<std::string> errors(n_chunks);
+
+#pragma omp parallel for schedule(dynamic) default(none) \
+        shared(bounds, first_row, n_chunks, end, delim, keep, columns, values, pitch, errors)
+    for (long long k = 0; k < static_cast<long long>(n_chunks); ++k) {
+        std::vector<double> row(columns);
+        size_t index = first_row[k];
+
+        try {
+            for (const char *line = bounds[k]; line < bounds[k + 1];) {
+                const char *next = line_end(line, end);
+
+                if (!is_blank(line, next)) {
+                    if (parse_csv_line(line, next, delim, keep, row.data()) != keep.size()) {
+                        throw std::invalid_argument("Wrong number of columns");
+                    }
+
+                    for (size_t j = 0; j < columns; ++j) {
+                        values[j * pitch + index] = row[j];
+                    }
+                    ++index;
+                }
+
+                line = next == end ? end : next + 1;
             }
-            this->data.push_back(std::stod(temp[i]));
+        }
+        catch (const std::exception &e) {
+            errors[k] = e.what();
         }
     }
-}
 
-std::vector<std::string> Table::split(const std::string &str, char delim) {
-    std::vector<std::string> ans;
-    std::istringstream inp(str);
-
-    for (std::string word; std::getline(inp, word, delim);) {
-        ans.push_back(word);
+    for (const auto &error : errors) {
+        if (!error.empty()) {
+            throw std::invalid_argument(error);
+        }
     }
-
-    return ans;
 }
 
 std::ostream& operator<<(std::ostream &out, const Table &a) {
@@ -52,7 +124,7 @@ std::ostream& operator<<(std::ostream &out, const Table &a) {
 
     for (size_t i = 0; i < a.rows; ++i) {
         for (size_t j = 0; j < a.columns; ++j) {
-            out << a.data[i * a.columns + j] << "\t";
+            out << (*a.data)[a.offset(j) + i] << "\t";
         }
         out << std::endl;
     }
@@ -73,7 +145,8 @@ double &Table::at(size_t row, size_t column) {
         throw std::out_of_range("Out of range");
     }
 
-    return this->data.at(row * this->columns + column);
+    this->detach();
+    return (*this->data)[column * this->pitch + row];
 }
 
 const double &Table::at(size_t row, size_t column) const {
@@ -81,64 +154,103 @@ const double &Table::at(size_t row, size_t column) const {
         throw std::out_of_range("Out of range");
     }
 
-    return this->data[row * this->columns + column];
+    return (*this->data)[this->offset(column) + row];
 }
 
-void Table::set_rows_count(size_t rows) {
-    if (this->rows > rows) {
-        this->data.erase(std::prev(this->data.end(), this->columns * (this->rows - rows)), this->data.end());
+void Table::detach() {
+    if (this->data.use_count() == 1 && !this->period) {
+        return;
     }
-    else if (this->rows < rows) {
-        this->data.resize(rows * this->columns);
+
+    const size_t pitch = this->period ? (this->rows + alignment - 1) / alignment * alignment : this->pitch;
+    auto data = std::make_shared<Storage>(this->columns * pitch, 0.0);
+
+    for (size_t j = 0; j < this->columns; ++j) {
+        const auto first = this->data->begin() + static_cast<std::ptrdiff_t>(this->offset(j));
+        std::copy(first, first + static_cast<std::ptrdiff_t>(this->rows), data->begin() + j * pitch);
     }
 
-    this->rows = rows;
+    this->data = data;
+    this->pitch = pitch;
+    this->period = 0;
 }
 
-void Table::set_column_count(size_t columns) {
-    if (this->columns > columns) {
-        auto it = std::next(this->data.begin(), columns);
-        for (size_t i = 0; i < this->rows; it += columns, ++i) {
-            it = this->data.erase(it, std::next(it, this->columns - columns));
-        }
+void Table::reserve_rows(size_t rows) {
+    this->detach();
+
+    if (rows <= this->pitch) {
+        return;
+    }
+
+    size_t new_pitch = std::max(rows, 2 * this->pitch);
+    new_pitch = (new_pitch + alignment - 1) / alignment * alignment;
+
+    auto new_data = std::make_shared<Storage>(new_pitch * this->columns, 0.0);
+    for (size_t j = 0; j < this->columns; ++j) {
+        std::copy(this->data->begin() + j * this->pitch, this->data->begin() + j * this->pitch + this->rows,
+                  new_data->begin() + j * new_pitch);
     }
-    else if (this->columns < columns) {
-        auto it = std::next(this->data.begin(), this->columns);
-        for (size_t i = 0; i < this->rows; ++i, it += columns) {
-            it = this->data.insert(it, columns - this->columns, 0.0);
+
+    this->data = new_data;
+    this->pitch = new_pitch;
+}
+
+void Table::set_rows_count(size_t rows) {
+    if (this->rows < rows) {
+        this->reserve_rows(rows);
+        for (size_t j = 0; j < this->columns; ++j) {
+            std::fill(this->data->begin() + j * this->pitch + this->rows,
+                      this->data->begin() + j * this->pitch + rows, 0.0);
         }
     }
 
+    this->rows = rows;
+}
+
+void Table::set_column_count(size_t columns) {
+    this->detach();
+    this->data->resize(columns * this->pitch, 0.0);
+
+    if (this->columns < columns) {
+        std::fill(this->data->begin() + this->columns * this->pitch, this->data->end(), 0.0);
+    }
+
     this->columns = columns;
 }
 
 std::vector<double> Table::get_column(size_t column) const {
-    if (column >= this->columns) {
-        throw std::out_of_range("Out of range");
-    }
+    return this->column(column).to_vector();
+}
 
-    std::vector<double> ans;
-    ans.reserve(this->rows);
+std::vector<double> Table::get_row(size_t row) const {
+    return this->row(row).to_vector();
+}
 
-    for (size_t i = 0; i < this->rows; ++i) {
-        ans.push_back(this->data[i * this->columns + column]);
+Array_view Table::column(size_t column) const {
+    if (column >= this->columns) {
+        throw std::out_of_range("Out of range");
     }
 
-    return ans;
+    return {this->data->data() + this->offset(column), this->rows};
 }
 
-std::vector<double> Table::get_row(size_t row) const {
+Array_view Table::row(size_t row) const {
     if (row >= this->rows) {
         throw std::out_of_range("Out of range");
     }
 
-    std::vector<double> ans;
-    ans.reserve(this->columns);
+    return {this->data->data() + row, this->columns, this->pitch, this->period, this->period ? size_t(1) : size_t(0)};
+}
 
-    for (size_t i = 0; i < this->columns; ++i) {
-        ans.push_back(this->data[row * this->columns + i]);
+Table Table::prefix(size_t rows, size_t columns) const {
+    if (rows > this->rows || columns > this->columns) {
+        throw std::out_of_range("Out of range");
     }
 
+    Table ans(*this);
+    ans.rows = rows;
+    ans.columns = columns;
+
     return ans;
 }
 
@@ -147,10 +259,11 @@ void Table::push_back_row(const std::vector<double> &row) {
         throw std::invalid_argument("Wrong number of columns");
     }
 
-    ++this->rows;
-    for (const auto &i : row) {
-        this->data.push_back(i);
+    this->reserve_rows(this->rows + 1);
+    for (size_t j = 0; j < this->columns; ++j) {
+        (*this->data)[j * this->pitch + this->rows] = row[j];
     }
+    ++this->rows;
 }
 
 void Table::push_back_column(const std::vector<double> &column) {
@@ -158,21 +271,24 @@ void Table::push_back_column(const std::vector<double> &column) {
         throw std::invalid_argument("Wrong number of rows");
     }
 
-    auto it = std::next(this->data.begin(), this->columns);
-
-    for (const auto &i : column) {
-        it = this->data.insert(it, i);
-        it += this->columns + 1;
-    }
+    this->detach();
+    this->data->resize((this->columns + 1) * this->pitch, 0.0);
+    std::copy(column.begin(), column.end(), this->data->begin() + this->columns * this->pitch);
 
     ++this->columns;
 }
 
 void Table::load_from_array(double *arr, size_t n, size_t m) {
-    this->rows = n;
+    this->rows = 0;
     this->columns = m;
+    this->pitch = 0;
+    this->data = std::make_shared<Storage>();
+    this->reserve_rows(n);
+    this->rows = n;
 
-    for (size_t i = 0; i < n * m; ++i) {
-        this->data.push_back(arr[i]);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < m; ++j) {
+            (*this->data)[j * this->pitch + i] = arr[i * m + j];
+        }
     }
 }
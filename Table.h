@@ -3,9 +3,15 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 #include <unordered_set>
-#include <deque>
+#include "Aligned_allocator.h"
+#include "Array_view.h"
 
+/// Table of doubles stored column by column
+///
+/// Copies and views share the storage, it is copied only when a shared table is modified.
+/// A lagged table (see series_to_supervised) reads every column as a shifted column of another table.
 class Table {
 public:
     Table() = default;
@@ -50,6 +56,22 @@ public:
         size_t row ///< Row index
     ) const;
 
+    /// Function returning a non-owning contiguous view of a table column
+    Array_view column(
+        size_t column ///< Column index
+    ) const;
+
+    /// Function returning a non-owning strided view of a table row
+    Array_view row(
+        size_t row ///< Row index
+    ) const;
+
+    /// Function returning a view of the first rows and columns of a table without copying data
+    Table prefix(
+        size_t rows,   ///< Number of rows in the view
+        size_t columns ///< Number of columns in the view
+    ) const;
+
     /// Function that inserts a row at the end of a table
     void push_back_row(
         const std::vector<double> &row ///< New row
@@ -76,12 +98,31 @@ public:
     friend Table series_to_supervised(const Table &data, int n_in, int n_out);
 
 private:
-    static std::vector<std::string> split(const std::string &str, char delim);
+    /// Function that makes the table the only owner of its storage in the plain layout before modification
+    void detach();
+
+    /// Function that returns the position of the first element of a column in the storage
+    size_t offset(
+        size_t column ///< Column index
+    ) const {
+        return this->period ? (column % this->period) * this->pitch + column / this->period : column * this->pitch;
+    }
+
+    /// Function that guarantees space for the specified number of rows in every column
+    void reserve_rows(
+        size_t rows ///< Required number of rows
+    );
 
 private:
-    size_t rows = 0;         ///< Number of rows in the table
-    size_t columns = 0;      ///< Number of columns in the table
-    std::deque<double> data; ///< Table data
+    typedef std::vector<double, Aligned_allocator<double>> Storage;
+
+    constexpr static size_t alignment = 64 / sizeof(double); ///< Column alignment in elements (one cache line)
+
+    size_t rows = 0;                                      ///< Number of rows in the table
+    size_t columns = 0;                                   ///< Number of columns in the table
+    size_t pitch = 0;                                     ///< Distance between the beginnings of neighbouring columns
+    size_t period = 0;                                    ///< Number of stored columns a lagged table cycles through (0 - plain layout)
+    std::shared_ptr<Storage> data = std::make_shared<Storage>(); ///< Table data stored column by column (shared by views)
 };
 
 
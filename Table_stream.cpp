@@ -0,0 +1,103 @@
+#include "Table_stream.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include "Csv_parser.h"
+
+Table_stream::Table_stream(const std::string &file_name, const std::unordered_set<std::string> &ignored_columns,
+                           char delim, size_t block_rows) : inp(file_name, std::ios::binary), delim(delim),
+                                                            block_rows(block_rows)
+{
+    if (!this->inp.is_open()) {
+        throw std::invalid_argument("Failed to open file");
+    }
+
+    if (!this->block_rows) {
+        throw std::invalid_argument("block_rows must be greater than 0");
+    }
+
+    std::string header;
+    std::getline(this->inp, header);
+
+    this->keep = parse_csv_header(header, delim, ignored_columns);
+    this->columns = static_cast<size_t>(std::count(this->keep.begin(), this->keep.end(), 1));
+    this->current.set_column_count(this->columns);
+    this->body = this->inp.tellg();
+
+    this->read_ahead();
+}
+
+Table Table_stream::read_block() {
+    Table ans;
+    ans.set_column_count(this->columns);
+
+    std::vector<double> row(this->columns);
+    std::string line;
+
+    while (ans.get_rows_count() < this->block_rows && std::getline(this->inp, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        if (parse_csv_line(line.data(), line.data() + line.size(), this->delim, this->keep, row.data()) !=
+            this->keep.size()) {
+            throw std::invalid_argument("Wrong number of columns");
+        }
+
+        ans.push_back_row(row);
+    }
+
+    return ans;
+}
+
+void Table_stream::read_ahead() {
+    this->ahead = std::async(std::launch::async, &Table_stream::read_block, this);
+}
+
+bool Table_stream::next() {
+    if (!this->ahead.valid()) {
+        // A failed read consumed the block ahead, the position in the file is unknown until rewind
+        throw std::logic_error("The stream must be rewound after a read error");
+    }
+
+    Table block = this->ahead.get();
+    this->first_row += this->current.get_rows_count();
+    this->current = std::move(block);
+
+    if (!this->current.get_rows_count()) {
+        // The end of the file stays reached until rewind
+        this->ahead = std::async(std::launch::deferred, [this]{Table ans; ans.set_column_count(this->columns); return ans;});
+        return false;
+    }
+
+    this->read_ahead();
+
+    return true;
+}
+
+const Table &Table_stream::block() const {
+    return this->current;
+}
+
+size_t Table_stream::get_block_first_row() const {
+    return this->first_row;
+}
+
+size_t Table_stream::get_columns_count() const {
+    return this->columns;
+}
+
+void Table_stream::rewind() {
+    if (this->ahead.valid()) {
+        this->ahead.wait();
+    }
+
+    this->inp.clear();
+    this->inp.seekg(this->body);
+    this->first_row = 0;
+    this->current = Table();
+    this->current.set_column_count(this->columns);
+
+    this->read_ahead();
+}
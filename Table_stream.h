@@ -0,0 +1,63 @@
+#ifndef TREE_TABLE_STREAM_H
+#define TREE_TABLE_STREAM_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <future>
+#include <unordered_set>
+#include "Table.h"
+
+/// Table read from a delimited text file in blocks of rows
+///
+/// Only the current block and the next one (read ahead in the background) are kept in memory,
+/// so files larger than the available memory can be passed over any number of times.
+class Table_stream {
+public:
+    explicit Table_stream(
+        const std::string &file_name,                                ///< The path to the file
+        const std::unordered_set<std::string> &ignored_columns = {}, ///< Ignored column names
+        char delim = ',',                                            ///< Separator between columns data
+        size_t block_rows = 1 << 16                                  ///< Maximum number of rows in a block
+    );
+
+    Table_stream(const Table_stream &) = delete;
+    Table_stream& operator=(const Table_stream &) = delete;
+
+    /// Function that makes the next block of rows current, returns false after the last block
+    /// (a read error is rethrown once, the stream must then be rewound)
+    bool next();
+
+    /// Function that returns the current block of rows
+    const Table& block() const;
+
+    /// Function that returns the index of the first row of the current block in the file
+    size_t get_block_first_row() const;
+
+    /// Function that returns the number of columns in the table
+    size_t get_columns_count() const;
+
+    /// Function that moves to the beginning of the file, the first block becomes current after next
+    void rewind();
+
+private:
+    /// Function that reads the block following the last read one (runs in the background)
+    Table read_block();
+
+    /// Function that starts reading the next block in the background
+    void read_ahead();
+
+private:
+    std::ifstream inp;          ///< Input file
+    std::streampos body;        ///< Position of the first line after the header
+    char delim;                 ///< Separator between columns data
+    size_t block_rows;          ///< Maximum number of rows in a block
+    size_t columns;             ///< Number of columns in the table
+    size_t first_row = 0;       ///< Index of the first row of the current block
+    std::vector<char> keep;     ///< Non-zero for the parsed fields of a line
+    Table current;              ///< Current block of rows
+    std::future<Table> ahead;   ///< Next block of rows being read (must be the last member, it is waited for first)
+};
+
+
+#endif //TREE_TABLE_STREAM_H
@@ -1,103 +1,165 @@
 #include "Tools.h"
 
 #include <iostream>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
 #include "Regression_tree.h"
+#include "Profiler.h"
 
-#define TEST 1
-#if TEST
-#include <chrono>
-#endif
-
-double mean_absolute_error(const std::vector<std::vector<double>> &observation, const std::vector<std::vector<double>> &predictions) {
+double mean_absolute_error(const Matrix &observation, const Matrix &predictions) {
     double ans = 0;
+    const size_t n_rows = observation.get_rows_count(), n_columns = observation.get_columns_count();
+
+    for (size_t i = 0; i < n_rows; ++i) {
+        const double *actual = observation.row_data(i);
+        const double *estimated = predictions.row_data(i);
 
-    for (size_t i = 0; i < observation.size(); ++i) {
-        for (size_t j = 0; j < observation[i].size(); ++j) {
-            ans += std::abs(predictions[i][j] - observation[i][j]) /
-                   static_cast<double>(observation.size() * observation.front().size());
+        for (size_t j = 0; j < n_columns; ++j) {
+            ans += std::abs(estimated[j] - actual[j]) / static_cast<double>(n_rows * n_columns);
         }
     }
 
     return ans;
 }
 
-#if TEST
-std::chrono::microseconds res_time, one_fit_time;
-#endif
-
-std::vector<double> abstract_regressor_forecast(Abstract_regressor &regressor,
-                                                const Table &train,
-                                                const std::vector<double> &test,
-                                                int n_observation)
+double walk_forward_validation(Abstract_regressor &regressor, const Table &data, int n_test, int n_observation,
+                               int n_threads)
 {
-    Table x;
-    std::vector<std::vector<double>> y(train.get_rows_count());
+    if (n_test <= 0 || static_cast<size_t>(n_test) >= data.get_rows_count()) {
+        throw std::invalid_argument("n_test must be in the interval [1, rows count)");
+    }
 
-    x.set_column_count(train.get_columns_count() - n_observation);
-    for (size_t i = 0; i < train.get_rows_count(); ++i) {
-        for (size_t j = train.get_columns_count() - n_observation; j < train.get_columns_count(); ++j) {
-            y[i].push_back(train.at(i, j));
+    if (n_threads < 1) {
+        throw std::invalid_argument("n_threads must be greater than or equal to 1");
+    }
+
+    const size_t n_train = data.get_rows_count() - n_test;
+    const size_t n_features = data.get_columns_count() - n_observation;
+    const Table x = data.prefix(data.get_rows_count(), n_features);
+
+    Matrix y(data.get_rows_count(), n_observation);
+    for (size_t i = 0; i < y.get_rows_count(); ++i) {
+        double *row = y.row_data(i);
+        for (size_t j = n_features; j < data.get_columns_count(); ++j) {
+            row[j - n_features] = data.at(i, j);
         }
-        auto r = train.get_row(i);
-        r.erase(std::prev(r.end(), n_observation), r.end());
-        x.push_back_row(r);
     }
 
-#if TEST
-    auto start = std::chrono::high_resolution_clock::now();
-    regressor.fit(x, y);
-    auto stop = std::chrono::high_resolution_clock::now();
-    one_fit_time = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
-    res_time += one_fit_time;
-#else
-    regressor.fit(x, y);
-#endif
-
-    return regressor.predict(test);
-}
+    // Every fold writes only its own row of the results
+    Matrix predictions(n_test, n_observation), observation(n_test, n_observation);
+    double *predicted_rows = predictions.row_data(0);
+    double *observed_rows = observation.row_data(0);
+    const bool profiling = Profiler::is_enabled();
+    Profile total_profile;
+
+    // Fits a regressor on the rows preceding the test row of a fold and predicts that row
+    const auto run_fold = [&](int i, Profile &fold_profile) {
+        const size_t n_rows = n_train + i;
+        std::unique_ptr<Abstract_regressor> copy;
+        Abstract_regressor &fold_regressor = n_threads > 1 ? *(copy = regressor.clone()) : regressor;
+
+        const Table train_x = x.prefix(n_rows, n_features);
+        const Matrix train_y = y.prefix(n_rows);
+
+        {
+            Profile_scope scope(profiling ? &fold_profile : nullptr);
+            Phase_timer timer(Phase::fit);
+            fold_regressor.fit(train_x, train_y);
+        }
+
+        const std::vector<double> prediction = fold_regressor.predict(x.get_row(n_rows));
+        std::copy(prediction.begin(), prediction.end(), predicted_rows + i * n_observation);
+        std::copy(y.row_data(n_rows), y.row_data(n_rows) + n_observation, observed_rows + i * n_observation);
+    };
 
-double walk_forward_validation(Abstract_regressor &regressor, const Table &data, int n_test, int n_observation) {
-    auto data_split = train_test_split(data, n_test);
-    std::vector<std::vector<double>> predictions, observation;
+    // Prints the result of a fold, folds are reported in order
+    const auto report_fold = [&](int i, const Profile &fold_profile) {
+        const double *predicted = predicted_rows + i * n_observation;
+        const double *observed = observed_rows + i * n_observation;
 
-    for (int i = 0; i < n_test; ++i) {
+        std::cout << ">expected=";
 
-        std::vector<double> testY = data_split.second.get_row(i);
-        observation.emplace_back();
-        observation.back().reserve(n_observation);
-        for (size_t j = testY.size() - n_observation; j < testY.size(); ++j) {
-            observation.back().push_back(testY[j]);
+        for (int j = 0; j + 1 < n_observation; ++j) {
+            std::cout << observed[j] << ", ";
         }
-        testY.erase(std::prev(testY.end(), n_observation), testY.end());
+        std::cout << observed[n_observation - 1] << ", predicted=";
 
-        predictions.emplace_back(abstract_regressor_forecast(regressor, data_split.first, testY, n_observation));
-        data_split.first.push_back_row(data_split.second.get_row(i));
+        for (int j = 0; j + 1 < n_observation; ++j) {
+            std::cout << predicted[j] << ", ";
+        }
 
-        std::cout << ">expected=";
+        std::cout << predicted[n_observation - 1] << std::endl;
 
-        for (size_t j = 0; j + 1 < observation.back().size(); ++j) {
-            std::cout << observation.back()[j] << ", ";
+        if (profiling) {
+            total_profile.merge(fold_profile);
+            std::cout << "One fit time: " << fold_profile.get_seconds(Phase::fit) << " s.\n\n";
         }
-        std::cout << observation.back().back() << ", predicted=";
+    };
 
-        for (size_t j = 0; j + 1 < predictions.back().size(); ++j) {
-            std::cout << predictions.back()[j] << ", ";
+    if (n_threads == 1) {
+        for (int i = 0; i < n_test; ++i) {
+            Profile fold_profile;
+            run_fold(i, fold_profile);
+            report_fold(i, fold_profile);
+        }
+    }
+    else {
+        // Exceptions must not leave the parallel region: the first failed fold stops the report
+        // and its exception is rethrown once all folds are done
+        std::vector<std::exception_ptr> errors(n_test);
+        bool failed = false;
+
+#pragma omp parallel for ordered schedule(dynamic) num_threads(n_threads) \
+        shared(run_fold, report_fold, errors, failed, n_test)
+        for (int i = 0; i < n_test; ++i) {
+            Profile fold_profile;
+
+            try {
+                run_fold(i, fold_profile);
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+            }
+
+#pragma omp ordered
+            {
+                failed = failed || errors[i];
+
+                if (!failed) {
+                    report_fold(i, fold_profile);
+                }
+            }
         }
 
-        std::cout << predictions.back().back() << std::endl;
-#if TEST
-        std::cout << "One fit time: " << static_cast<double>(one_fit_time.count()) * 1e-6 << " s.\n\n";
-#endif
+        for (const auto &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
     }
 
-#if TEST
-    std::cout << "Total fit time: " << static_cast<double>(res_time.count()) * 1e-6 << " s.\n";
-    std::cout << "Mean fit time: " << static_cast<double>(res_time.count()) / static_cast<double>(n_test) * 1e-6 << " s.\n";
-#endif
+    if (profiling) {
+        const double fit_time = total_profile.get_seconds(Phase::fit);
+        std::cout << "Total fit time: " << fit_time << " s.\n";
+        std::cout << "Mean fit time: " << fit_time / static_cast<double>(n_test) << " s.\n";
+        std::cout << total_profile.to_text();
+    }
 
     return mean_absolute_error(observation, predictions);
 }
 
+Matrix predict_stream(const Abstract_regressor &regressor, Table_stream &values) {
+    Matrix ans;
+
+    for (values.rewind(); values.next();) {
+        ans.append(regressor.predict(values.block()));
+    }
+
+    return ans;
+}
+
 std::pair<Table, Table> train_test_split(const Table &data, int n_tests)
 {
     std::pair<Table, Table> ans;
@@ -124,14 +186,16 @@ Table series_to_supervised(const Table &data, int n_in, int n_out) {
         return {};
     }
 
-    Table ans;
-    ans.rows = new_rows;
-    ans.columns = new_columns;
-
-    for (size_t i = 0, shift = 0; i < new_rows; ++i, shift += data.columns) {
-        auto it = data.data.begin() + shift;
-        std::copy(it, it + new_columns, std::back_inserter(ans.data));
+    // Column j of the result is column j % columns of the series shifted by j / columns rows,
+    // so the result only refers to the storage of the series
+    Table ans(data);
+    if (ans.period) {
+        ans.detach();
     }
 
+    ans.period = data.columns;
+    ans.columns = new_columns;
+    ans.rows = new_rows;
+
     return ans;
 }
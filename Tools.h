@@ -6,11 +6,13 @@
 #include <map>
 #include "Abstract_regressor.h"
 #include "Table.h"
+#include "Matrix.h"
+#include "Table_stream.h"
 
 /// Mean absolute error calculation function
 double mean_absolute_error(
-    const std::vector<std::vector<double>> &observation, ///< Actual value matrix
-    const std::vector<std::vector<double>> &predictions  ///< Estimated value matrix
+    const Matrix &observation, ///< Actual value matrix
+    const Matrix &predictions  ///< Estimated value matrix
 );
 
 /// Function of splitting the original set into test and training sets
@@ -20,11 +22,25 @@ std::pair<Table, Table> train_test_split(
 );
 
 /// Function to check the quality of the model using the walk forward validation method
+///
+/// Every fold trains on a view of all rows preceding its test row. With n_threads > 1 the folds run concurrently
+/// on untrained copies of the regressor in one team of n_threads threads: a regressor opening a parallel region of its
+/// own (a forest) gets a single thread there, a tree grown by OpenMP tasks spawns them into the team, where threads
+/// waiting for the remaining folds run them. The output stays in fold order, the exception of the first failed fold
+/// is rethrown once the running folds finish.
+/// With the profiler enabled (see Profiler::set_enabled) the fit time of every fold and the phase totals are printed.
 double walk_forward_validation(
     Abstract_regressor &regressor, ///< Model under test
     const Table &data,             ///< Data set for test
     int n_test,                    ///< Number of tests
-    int n_observation              ///< Number of observations on which the model will be trained
+    int n_observation,             ///< Number of observations on which the model will be trained
+    int n_threads = 1              ///< Number of folds run concurrently
+);
+
+/// Prediction function for a streamed table, every block is predicted while the next one is being read
+Matrix predict_stream(
+    const Abstract_regressor &regressor, ///< Trained model
+    Table_stream &values                 ///< Streamed feature sets
 );
 
 /// Time series to data transformation function for supervised learning
@@ -0,0 +1,1459 @@
+#ifndef TREE_TREE_ENGINE_H
+#define TREE_TREE_ENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Abstract_regressor.h"
+#include "Split_search.h"
+#include "Histogram.h"
+#include "Compiled_forest.h"
+#include "Arena.h"
+#include "Random_generator.h"
+#include "Profiler.h"
+#include "omp.h"
+
+/// Order in which the nodes of a tree are grown
+///
+/// Both orders run the same split search, but they sum the node histograms in a different row order, so the grown
+/// trees may differ where candidate splits tie or the rounding of the sums decides between them.
+enum class Growth_order {
+    depth_first, ///< Every node partitions its rows and grows its subtrees (in tasks) before its siblings finish
+    level_wise   ///< All nodes of one depth are split together after one pass over the training rows (histogram only)
+};
+
+/// Feature sampling policy: every node searches all features
+class All_features {
+public:
+    /// Function that restarts the sampling before a new fit
+    void restart() {}
+
+    /// Function that returns the sampling of a child node
+    All_features child() const {
+        return *this;
+    }
+
+    /// Function that calls f for every feature searched in a node
+    template <class Function>
+    void for_each(
+        size_t n_features, ///< Number of features
+        const Function &f  ///< Function of a feature index
+    ) const {
+        for (size_t feature = 0; feature < n_features; ++feature) {
+            f(feature);
+        }
+    }
+};
+
+/// Feature sampling policy: every node searches a random subset of features (random forest style)
+class Random_features {
+public:
+    explicit Random_features(
+        double fraction = 1.0,                ///< Proportion of features used
+        uint64_t seed = std::random_device()() ///< Seed of the sampling (random by default)
+    ) : fraction(fraction), seed(seed), generator(seed) {
+        if (this->fraction > 1.0 || this->fraction < std::numeric_limits<double>::epsilon()) {
+            throw std::invalid_argument("X_features_fraction must be in the interval (0.0, 1.0] ");
+        }
+    }
+
+    /// Function that restarts the sampling from its seed before a new fit
+    void restart() {
+        this->generator = Random_generator(this->seed);
+    }
+
+    /// Function that returns the sampling of a child node, seeded from this one
+    Random_features child() const {
+        return Random_features(this->fraction, this->generator());
+    }
+
+    /// Function that calls f for every feature searched in a node
+    template <class Function>
+    void for_each(
+        size_t n_features, ///< Number of features
+        const Function &f  ///< Function of a feature index
+    ) const {
+        auto n_ft = static_cast<size_t>(static_cast<double>(n_features) * this->fraction);
+
+        if (!n_ft) {
+            n_ft = 1;
+        }
+
+        std::vector<size_t> indices(n_features);
+        std::iota(indices.begin(), indices.end(), 0);
+
+        // Partial Fisher-Yates shuffle: only the first n_ft positions are drawn
+        for (size_t i = 0; i < n_ft; ++i) {
+            std::swap(indices[i], indices[i + this->generator.uniform(n_features - i)]);
+        }
+
+        for (size_t i = 0; i < n_ft; ++i) {
+            f(indices[i]);
+        }
+    }
+
+    /// Function that returns the proportion of features used
+    double get_fraction() const {
+        return this->fraction;
+    }
+
+    /// Function that returns the seed of the sampling
+    uint64_t get_seed() const {
+        return this->seed;
+    }
+
+private:
+    double fraction;                    ///< Proportion of features used (Accepts values from 0.0 to 1.0)
+    uint64_t seed;                      ///< Seed of the sampling, the generator restarts from it on fit
+    mutable Random_generator generator; ///< Sampling generator (child samplings are seeded from it)
+};
+
+/// Growth policy: the nodes of a tree are built one after another by the calling thread
+struct Sequential_growth {
+    /// Function that builds a tree
+    template <class Function>
+    static void run(const Function &grow) {
+        grow();
+    }
+
+    /// Function that builds a subtree
+    template <class Function>
+    static void spawn(const Function &grow) {
+        grow();
+    }
+
+    /// Function that waits for the subtrees spawned by the current node
+    static void wait() {}
+
+    /// Function that returns the number of threads available to the split search of one node
+    /// (a tree built inside a parallel region, such as a forest tree, keeps to its thread)
+    static size_t threads() {
+        return omp_in_parallel() ? 1 : static_cast<size_t>(omp_get_max_threads());
+    }
+
+    /// Function that calls f for every index below count in a new parallel region,
+    /// the measurements of all threads of the region are added to the profile of the calling thread
+    template <class Function>
+    static void parallel_for(size_t count, const Function &f) {
+        Profile *profile = Profiler::current();
+        const auto n = static_cast<long long>(count);
+
+        #pragma omp parallel default(none) shared(f, profile, n)
+        {
+            Profile thread_profile;
+            Profile_scope scope(profile ? &thread_profile : nullptr);
+
+            #pragma omp for schedule(dynamic)
+            for (long long i = 0; i < n; ++i) {
+                f(static_cast<size_t>(i));
+            }
+
+            if (profile) {
+                #pragma omp critical(tree_profile)
+                profile->merge(thread_profile);
+            }
+        }
+    }
+};
+
+/// Growth policy: subtrees are built by OpenMP tasks
+///
+/// A tree grown inside a parallel region (for example a forest tree) spawns its tasks into the team of that region,
+/// so trees, nodes and features share one pool of threads. Every task records into a profile of its own and adds it
+/// to the profile the tree was grown with when it finishes, so tasks of different trees can share a thread.
+struct Task_growth {
+    /// Function that builds a tree, in a new parallel region unless the caller already runs in one
+    template <class Function>
+    static void run(const Function &grow) {
+        Profile *profile = Profiler::current();
+
+        if (omp_in_parallel()) {
+            record(profile, grow);
+            return;
+        }
+
+        #pragma omp parallel default(none) shared(grow, profile)
+        {
+            #pragma omp single
+            record(profile, grow);
+        }
+    }
+
+    /// Function that builds a subtree in a new task
+    template <class Function>
+    static void spawn(const Function &grow) {
+        const Function task(grow);
+        Profile *profile = target();
+
+        #pragma omp task default(none) firstprivate(task, profile)
+        {
+            record(profile, task);
+        }
+    }
+
+    /// Function that waits for the subtrees spawned by the current node
+    static void wait() {
+        #pragma omp taskwait
+    }
+
+    /// Function that returns the number of threads available to the split search of one node
+    static size_t threads() {
+        return static_cast<size_t>(omp_get_num_threads());
+    }
+
+    /// Function that calls f for every index below count in tasks of the current parallel region and waits for them
+    template <class Function>
+    static void parallel_for(size_t count, const Function &f) {
+        const auto n = static_cast<long long>(count);
+        Profile *profile = target();
+
+        #pragma omp taskloop default(none) shared(f, n) firstprivate(profile) grainsize(1)
+        for (long long i = 0; i < n; ++i) {
+            record(profile, [&f, i]() {
+                f(static_cast<size_t>(i));
+            });
+        }
+    }
+
+private:
+    /// Function that returns the profile the tree grown by the current task records into (nullptr - none)
+    static Profile*& target() {
+        static thread_local Profile *profile = nullptr;
+        return profile;
+    }
+
+    /// Function that calls f recording into a profile of its own, which is then added to the tree profile
+    template <class Function>
+    static void record(
+        Profile *profile,  ///< Profile of the tree (nullptr - not profiled)
+        const Function &f  ///< Task body
+    ) {
+        Profile *previous = target();
+        target() = profile;
+
+        Profile own;
+        {
+            Profile_scope scope(profile ? &own : nullptr);
+            f();
+        }
+
+        if (profile) {
+            #pragma omp critical(tree_profile)
+            profile->merge(own);
+        }
+
+        target() = previous;
+    }
+};
+
+/// Regression tree parameterized at compile time
+///
+/// Sampling chooses the features searched in a node (All_features, Random_features), Growth schedules the
+/// subtrees (Sequential_growth, Task_growth), Thresholds generates split candidates from distinct feature values
+/// and Criterion scores them in batches. Accumulator is the type of the node sums and errors (the split scan itself
+/// runs in compensated double precision). N_OUT fixes the number of outputs (0 - any number), a tree with
+/// N_OUT = 0 still builds single-output data with the N_OUT = 1 kernels.
+template <typename Sampling, typename Growth, typename Thresholds = Moving_average_thresholds<2>,
+          typename Criterion = Mse_criterion, typename Accumulator = long double, size_t N_OUT = 0>
+class Tree_engine : public Abstract_regressor {
+public:
+    explicit Tree_engine(
+        size_t min_samples_split = 20,                   ///< Minimum sample size that can be at the node
+        size_t max_depth = 5,                            ///< Maximum tree depth
+        Split_method split_method = Split_method::exact, ///< Method of searching for the best split
+        const Sampling &sampling = Sampling(),           ///< Feature sampling of the root node
+        Growth_order growth_order = Growth_order::depth_first ///< Order of growing the nodes
+    );
+
+    /// Function that creates an untrained regressor with the same parameters
+    std::unique_ptr<Abstract_regressor> clone() const override;
+
+    /// Model training function
+    void fit(
+        const Table &x, ///< Feature set
+        const Matrix &y ///< Feature-related observations
+    ) override;
+
+    /// Model training function over weighted rows (bagging without copying the training set)
+    ///
+    /// A row with weight k counts as k identical rows in the node statistics and the split search,
+    /// rows with zero weight are left out.
+    void fit(
+        const Table &x,                    ///< Feature set
+        const Matrix &y,                   ///< Feature-related observations
+        const std::vector<size_t> &weights ///< Integer weight (multiplicity) of every row
+    );
+
+    /// Model training function over quantized features, splits are always searched by histogram
+    void fit(
+        const Binned_features &x, ///< Quantized feature set (for example built from a Table_stream)
+        const Matrix &y           ///< Feature-related observations
+    );
+
+    /// Model training function over quantized features and weighted rows
+    void fit(
+        const Binned_features &x,          ///< Quantized feature set
+        const Matrix &y,                   ///< Feature-related observations
+        const std::vector<size_t> &weights ///< Integer weight (multiplicity) of every row
+    );
+
+    /// Function that updates the trained tree with one new observation
+    ///
+    /// Node statistics along the path of the row are updated, the reached leaf keeps the observation and is
+    /// rebuilt from its kept observations once there are min_samples_split of them.
+    void partial_fit(
+        const std::vector<double> &row, ///< One feature set
+        const std::vector<double> &y    ///< Feature-related observation
+    ) override;
+
+    /// Function that updates the trained tree with one new observation repeated several times,
+    /// returns true if the tree structure changed
+    bool partial_fit(
+        const std::vector<double> &row, ///< One feature set
+        const std::vector<double> &y,   ///< Feature-related observation
+        size_t weight                   ///< Number of repetitions of the observation
+    );
+
+    /// Tree information output function
+    void print_tree() const;
+
+    /// Function that builds the flat inference representation of the trained tree
+    Compiled_forest compile() const;
+
+    /// Function that writes the trained tree to a binary model file (see Compiled_forest::load)
+    void save(
+        const std::string &file_name ///< The path to the file
+    ) const;
+
+    /// Prediction function for one set of features
+    std::vector<double> predict(
+        const std::vector<double> &values ///< One feature set
+    ) const override;
+
+    /// Prediction function for multiple feature sets
+    Matrix predict(
+        const Table &values ///< Multiple feature sets
+    ) const override;
+
+protected:
+    size_t min_samples_split;                  ///< Minimum sample size that can be at the node
+    size_t max_depth;                          ///< Maximum tree depth
+    Split_method split_method;                 ///< Method of searching for the best split
+    Sampling sampling;                         ///< Feature sampling of the node
+    Growth_order growth_order;                 ///< Order of growing the nodes
+
+private:
+    friend class Compiled_forest;
+    friend class Arena;
+
+    /// Constructor of a child node, the node is placed in the arena of its parent
+    Tree_engine(
+        const Tree_engine &parent, ///< Parent node
+        char node_type             ///< Node type (1 - Left node, 2 - Right node)
+    );
+
+    /// Function that releases all nodes below the root at once and starts a new arena for them
+    void reset_arena();
+
+    /// Function that throws if the observations do not have the fixed number of outputs
+    static void check_outputs(
+        size_t outputs ///< Number of outputs of the observations
+    );
+
+    /// Model training function over selected rows (indices may repeat)
+    void fit_rows(
+        const Table &x,        ///< Feature set
+        const Matrix &y,       ///< Feature-related observations
+        std::vector<int> &rows ///< Selected row indices
+    );
+
+    /// Model training function over selected quantized rows (indices may repeat)
+    void fit_rows(
+        const Binned_features &x, ///< Quantized feature set
+        const Matrix &y,          ///< Feature-related observations
+        std::vector<int> &rows    ///< Selected row indices
+    );
+
+    /// Function that returns true if the tree is built with the single-output kernels
+    static bool single_output(
+        size_t outputs ///< Number of outputs of the observations
+    ) {
+        return N_OUT == 1 || (N_OUT == 0 && outputs == 1);
+    }
+
+    /// Function that sets the prediction and the error of the node from its rows
+    template <size_t Outputs>
+    void set_statistics(
+        const Matrix &y, ///< Feature-related observations
+        const int *rows, ///< Node rows
+        size_t count     ///< Number of node rows
+    );
+
+    /// Function that searches the sampled features of a node for the best split
+    ///
+    /// Nodes of at least parallel_split_rows rows search their features in parallel: every feature is scored
+    /// against the node error alone and the results are reduced in the sampling order, so the split is the same
+    /// as the serial search finds whatever the number of threads.
+    template <class Scan>
+    std::pair<int, double> search_features(
+        size_t n_features, ///< Number of features
+        size_t count,      ///< Number of node rows
+        const Scan &scan   ///< Function that scans one feature (feature, best error, best split, buffers)
+    ) const;
+
+    /// Function that calls f for every index below count, in parallel by the growth policy if asked to
+    template <class Function>
+    static void for_each_index(
+        size_t count,     ///< Number of indices
+        bool parallel,    ///< Run the calls in parallel
+        const Function &f ///< Function of an index
+    ) {
+        if (!parallel || count < 2) {
+            for (size_t i = 0; i < count; ++i) {
+                f(i);
+            }
+            return;
+        }
+
+        Growth::parallel_for(count, f);
+    }
+
+    /// Function of calculating the best value and the best feature number for splitting node rows
+    template <size_t Outputs>
+    std::pair<int, double> get_best_split(
+        const Table &x,               ///< Feature set
+        const Matrix &y,              ///< Feature-related observations
+        const std::vector<int> &rows, ///< Row indices partitioned between nodes
+        size_t begin,                 ///< Beginning of the node range
+        size_t end                    ///< End of the node range
+    ) const;
+
+    /// Function of calculating the best value and the best feature number for splitting presorted node rows
+    template <size_t Outputs>
+    std::pair<int, double> get_best_split(
+        const Table &x,                     ///< Feature set
+        const Matrix &y,                    ///< Feature-related observations
+        const Presorted_features &features, ///< Rows sorted by each feature
+        size_t begin,                       ///< Beginning of the node range
+        size_t end                          ///< End of the node range
+    ) const;
+
+    /// Function of calculating the best bin and the best feature number for splitting node rows by histogram
+    std::pair<int, int> get_best_split(
+        const Histogram &hist,   ///< Histogram of the node rows
+        const Target_sums &sums, ///< Sums of the node observations
+        size_t count             ///< Number of node rows
+    ) const;
+
+    /// Function that partitions node rows in place, returns the beginning of the right child range
+    size_t split(
+        const Table &x,         ///< Feature set
+        std::vector<int> &rows, ///< Row indices partitioned between nodes
+        size_t begin,           ///< Beginning of the node range
+        size_t end              ///< End of the node range
+    ) const;
+
+    /// Tree building function
+    template <size_t Outputs>
+    void grow(
+        const Table &x,         ///< Feature set
+        const Matrix &y,        ///< Feature-related observations
+        std::vector<int> &rows, ///< Row indices partitioned between nodes
+        size_t begin,           ///< Beginning of the node range
+        size_t end              ///< End of the node range
+    );
+
+    /// Tree building function over quantized rows
+    template <size_t Outputs>
+    void grow(
+        const Binned_features &bins, ///< Quantized feature set
+        const Matrix &y,             ///< Feature-related observations
+        std::vector<int> &rows,      ///< Row indices partitioned between nodes
+        Histogram &hist,             ///< Histogram of the node rows (reused by the node children)
+        size_t begin,                ///< Beginning of the node range
+        size_t end                   ///< End of the node range
+    );
+
+    /// Tree building function over quantized rows, one depth at a time
+    ///
+    /// Every level makes one pass over the rows that routes them from the split nodes of the previous level to
+    /// their children and sums their observations, then one pass over each feature column that accumulates the
+    /// histograms of the level. Only the smaller child of every split gets a histogram built from the rows, the
+    /// larger one reuses the parent histogram minus the smaller one, so the histograms of a whole level (not of one
+    /// path as in depth-first growth) are held at once. Rows are summed in their original order rather than in the
+    /// partitioned order of depth-first growth, so ties between splits may be broken differently.
+    template <size_t Outputs>
+    void grow_levels(
+        const Binned_features &bins, ///< Quantized feature set
+        const Matrix &y,             ///< Feature-related observations
+        const std::vector<int> &rows ///< Selected row indices
+    );
+
+    /// Tree building function over presorted rows
+    template <size_t Outputs>
+    void grow(
+        const Table &x,                ///< Feature set
+        const Matrix &y,               ///< Feature-related observations
+        Presorted_features &features,  ///< Rows sorted by each feature
+        std::vector<char> &goes_right, ///< Row flags of the last split (non-zero if the row went right)
+        size_t begin,                  ///< Beginning of the node range
+        size_t end                     ///< End of the node range
+    );
+
+    /// Function that resets the split of the node before growing it
+    void reset_split();
+
+    /// Function that creates a child node one level deeper
+    Tree_engine* create_child(
+        char node_type ///< Child type (1 - Left node, 2 - Right node)
+    ) const;
+
+    /// Function that adds an observation to the statistics of the node and its subtree, returns true if a leaf was split
+    bool insert(
+        const std::vector<double> &row, ///< One feature set
+        const std::vector<double> &y,   ///< Feature-related observation
+        size_t weight                   ///< Number of repetitions of the observation
+    );
+
+    /// Function that tries to split the leaf by the observations it keeps, returns true on success
+    bool grow_pending();
+
+    /// Function that returns the leaf reached by a feature set
+    Tree_engine* get_leaf(
+        const std::vector<double> &row ///< One feature set
+    );
+
+    /// Node information output function
+    void print_info(size_t width = 4) const;
+
+private:
+    static constexpr size_t parallel_split_rows = 4096; ///< Minimum number of node rows searched in parallel
+
+    char node_type;                            ///< Node type (0 - Root node, 1 - Left node, 2 - Right node)
+    int best_feature;                          ///< Number of the best feature to split samples
+    size_t depth;                              ///< Current tree depth
+    size_t samples_size;                       ///< Current sample size in node
+    double best_value;                         ///< Best value to split samples
+    std::vector<double, Arena_allocator<double>> ymean; ///< Node prediction (placed in the tree arena)
+    Tree_engine *left;                         ///< Pointer to the left child of the node (owned by the tree arena)
+    Tree_engine *right;                        ///< Pointer to the right child of the node (owned by the tree arena)
+
+    std::vector<std::vector<double>> pending_x; ///< Feature sets kept by the leaf since it was grown (used by partial_fit)
+    std::vector<std::vector<double>> pending_y; ///< Observations kept by the leaf since it was grown
+
+    Accumulator mse;                           ///< Node mean square error
+    std::unique_ptr<Compiled_forest> compiled; ///< Flat inference representation (set in the root node by fit)
+    std::unique_ptr<Arena> nodes;              ///< Memory of all nodes below the root (set in the root node)
+    Arena *arena;                              ///< Arena of the tree the node belongs to
+};
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::Tree_engine(
+        size_t min_samples_split, size_t max_depth, Split_method split_method, const Sampling &sampling,
+        Growth_order growth_order) :
+        min_samples_split(min_samples_split), max_depth(max_depth), split_method(split_method),
+        sampling(sampling), growth_order(growth_order), node_type(0), best_feature(-1), depth(0), samples_size(0), best_value(0.0),
+        ymean{0}, left(nullptr), right(nullptr), mse(0), arena(nullptr)
+{
+    if (this->min_samples_split < Thresholds::window) {
+        throw std::invalid_argument("min_samples_split must be greater than or equal to " +
+                                    std::to_string(Thresholds::window));
+    }
+
+    if (this->growth_order == Growth_order::level_wise && this->split_method != Split_method::histogram) {
+        throw std::invalid_argument("Level-wise growth requires the histogram split method");
+    }
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::Tree_engine(
+        const Tree_engine &parent, char node_type) :
+        min_samples_split(parent.min_samples_split), max_depth(parent.max_depth),
+        split_method(parent.split_method), sampling(parent.sampling.child()), growth_order(parent.growth_order),
+        node_type(node_type),
+        best_feature(-1), depth(parent.depth + 1), samples_size(0), best_value(0.0),
+        ymean(Arena_allocator<double>(parent.arena)), left(nullptr), right(nullptr), mse(0),
+        arena(parent.arena) {}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+std::unique_ptr<Abstract_regressor>
+Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::clone() const {
+    return std::unique_ptr<Abstract_regressor>(new Tree_engine(this->min_samples_split, this->max_depth,
+                                                               this->split_method, this->sampling,
+                                                               this->growth_order));
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::check_outputs(size_t outputs) {
+    if (N_OUT && outputs != N_OUT) {
+        throw std::invalid_argument("Wrong number of observations");
+    }
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+template <size_t Outputs>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::set_statistics(
+        const Matrix &y, const int *rows, size_t count)
+{
+    const std::vector<double> mean = get_rows_mean<Outputs>(y, rows, count);
+    this->ymean.assign(mean.begin(), mean.end());
+    this->mse = get_rows_mse<Outputs, Accumulator>(y, rows, count, mean,
+                                                   static_cast<double>(count * mean.size()));
+    this->samples_size = count;
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+template <class Scan>
+std::pair<int, double> Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::search_features(
+        size_t n_features, size_t count, const Scan &scan) const
+{
+    std::vector<size_t> features;
+    this->sampling.for_each(n_features, [&features](size_t feature) {
+        features.push_back(feature);
+    });
+
+    const size_t threads = Growth::threads();
+    if (count < parallel_split_rows || threads < 2 || features.size() < 2) {
+        Accumulator mse_base = this->mse;
+        std::pair<int, double> ans(-1, 0.0);
+        Split_candidates candidates;
+        std::vector<int> indices;
+
+        for (size_t feature : features) {
+            scan(feature, mse_base, ans, candidates, indices);
+        }
+
+        return ans;
+    }
+
+    // Features are split into contiguous chunks, every chunk reuses its own buffers
+    const size_t n_chunks = std::min(features.size(), 4 * threads);
+    std::vector<Accumulator> errors(features.size(), this->mse);
+    std::vector<std::pair<int, double>> splits(features.size(), std::pair<int, double>(-1, 0.0));
+
+    Growth::parallel_for(n_chunks, [&](size_t chunk) {
+        Split_candidates candidates;
+        std::vector<int> indices;
+
+        for (size_t i = chunk * features.size() / n_chunks; i < (chunk + 1) * features.size() / n_chunks; ++i) {
+            scan(features[i], errors[i], splits[i], candidates, indices);
+        }
+    });
+
+    Accumulator mse_base = this->mse;
+    std::pair<int, double> ans(-1, 0.0);
+    for (size_t i = 0; i < features.size(); ++i) {
+        if (splits[i].first >= 0 && errors[i] < mse_base) {
+            ans = splits[i];
+            mse_base = errors[i];
+        }
+    }
+
+    return ans;
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+template <size_t Outputs>
+std::pair<int, double> Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::get_best_split(
+        const Table &x, const Matrix &y, const std::vector<int> &rows, size_t begin, size_t end) const
+{
+    const size_t count = end - begin;
+    const Basic_target_sums<Accumulator> sums = get_target_sums<Outputs, Accumulator>(y, rows.data() + begin, count);
+
+    return this->search_features(x.get_columns_count(), count, [&](size_t feature, Accumulator &mse_base,
+            std::pair<int, double> &ans, Split_candidates &candidates, std::vector<int> &indices) {
+        const Array_view arr = x.column(feature);
+
+        Phase_timer extraction(Phase::column_extraction);
+        indices.assign(rows.begin() + begin, rows.begin() + end);
+        extraction.stop();
+
+        Phase_timer sorting(Phase::sorting);
+        std::sort(indices.begin(), indices.end(), [&arr](int a, int b){return arr[a] < arr[b];});
+        sorting.stop();
+
+        scan_feature<Thresholds, Criterion, Outputs>(arr, indices.data(), count, y, sums,
+                                                     static_cast<int>(feature), mse_base, ans, candidates);
+    });
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+template <size_t Outputs>
+std::pair<int, double> Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::get_best_split(
+        const Table &x, const Matrix &y, const Presorted_features &features, size_t begin, size_t end) const
+{
+    const Basic_target_sums<Accumulator> sums = get_target_sums<Outputs, Accumulator>(y, features.order(0, begin),
+                                                                                       end - begin);
+
+    return this->search_features(x.get_columns_count(), end - begin, [&](size_t feature, Accumulator &mse_base,
+            std::pair<int, double> &ans, Split_candidates &candidates, std::vector<int> &) {
+        scan_feature<Thresholds, Criterion, Outputs>(x.column(feature), features.order(feature, begin), end - begin,
+                                                     y, sums, static_cast<int>(feature), mse_base, ans, candidates);
+    });
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+std::pair<int, int> Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::get_best_split(
+        const Histogram &hist, const Target_sums &sums, size_t count) const
+{
+    long double mse_base = this->mse;
+    std::pair<int, int> ans(-1, 0);
+
+    this->sampling.for_each(hist.get_features_count(), [&](size_t feature) {
+        hist.scan_feature(feature, count, sums, mse_base, ans);
+    });
+
+    return ans;
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+size_t Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::split(
+        const Table &x, std::vector<int> &rows, size_t begin, size_t end) const
+{
+    Phase_timer timer(Phase::partition);
+    const Array_view arr = x.column(this->best_feature);
+    const double value = this->best_value;
+
+    return std::partition(rows.begin() + begin, rows.begin() + end,
+                          [&arr, value](int row){return arr[row] <= value;}) - rows.begin();
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::print_info(size_t width) const {
+    size_t coef = this->depth * static_cast<size_t>(std::sqrt(width * width * width));
+    if (this->node_type == 0) {
+        std::cout << "Root\n";
+    }
+    else if (this->best_feature != -1) {
+        std::cout << std::string(coef, ' ') << (this->node_type == 1 ? "Left_node\n" : "Right_node\n");
+        std::cout << std::string(coef, ' ') << "  | Best value to split " << this->best_value << std::endl;
+        std::cout << std::string(coef, ' ') << "  | Best feature to split " << this->best_feature << std::endl;
+    }
+    else {
+        std::cout << std::string(coef, ' ') << (this->node_type == 1 ? "Left_node" : "Right_node") << " (leaf)\n";
+    }
+
+    std::cout << std::string(coef, ' ') << "  | MSE of the node: " << this->mse << std::endl;
+    std::cout << std::string(coef, ' ') << "  | Count of observations in node: " << this->samples_size << std::endl;
+    std::cout << std::string(coef, ' ') << "  | Prediction of node: ";
+
+    for (size_t i = 0; i + 1 < this->ymean.size(); i++) {
+        std::cout << this->ymean[i] << ", ";
+    }
+    std::cout << this->ymean.back() << std::endl;
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::print_tree() const {
+    this->print_info();
+
+    if (this->left) {
+        left->print_tree();
+    }
+
+    if (this->right) {
+        right->print_tree();
+    }
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+std::vector<double> Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::predict(
+        const std::vector<double> &values) const
+{
+    if (!this->compiled) {
+        return {this->ymean.begin(), this->ymean.end()};
+    }
+
+    return this->compiled->predict(values);
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+Matrix Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::predict(const Table &values) const {
+    if (!this->compiled) {
+        Matrix ans(values.get_rows_count(), this->ymean.size());
+        for (size_t i = 0; i < ans.get_rows_count(); ++i) {
+            std::copy(this->ymean.begin(), this->ymean.end(), ans.row_data(i));
+        }
+
+        return ans;
+    }
+
+    return this->compiled->predict(values);
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::save(
+        const std::string &file_name) const
+{
+    this->compile().save(file_name);
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+Compiled_forest Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::compile() const {
+    Compiled_forest ans;
+    ans.add_tree(*this);
+
+    return ans;
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>*
+Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::create_child(char node_type) const {
+    Phase_timer timer(Phase::node_allocation);
+    return this->arena->template create<Tree_engine>(*this, node_type);
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::reset_arena() {
+    this->left = nullptr;
+    this->right = nullptr;
+    this->nodes.reset(new Arena());
+    this->arena = this->nodes.get();
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::reset_split() {
+    this->best_feature = -1;
+    this->best_value = 0.0;
+    this->left = nullptr;
+    this->right = nullptr;
+    this->pending_x.clear();
+    this->pending_y.clear();
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+bool Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::partial_fit(
+        const std::vector<double> &row, const std::vector<double> &y, size_t weight)
+{
+    if (!this->samples_size) {
+        check_outputs(y.size());
+        this->ymean.assign(y.size(), 0);
+        this->reset_arena();
+    }
+    else if (y.size() != this->ymean.size()) {
+        throw std::invalid_argument("Wrong number of observations");
+    }
+
+    if (this->compiled && row.size() < this->compiled->get_features_count()) {
+        throw std::out_of_range("Out of range");
+    }
+
+    if (!weight) {
+        return false;
+    }
+
+    const bool resplit = this->insert(row, y, weight);
+
+    if (resplit || !this->compiled) {
+        this->compiled.reset(new Compiled_forest(this->compile()));
+    }
+    else {
+        const auto &leaf = this->get_leaf(row)->ymean;
+        this->compiled->set_leaf_values(0, Array_view(row.data(), row.size()), {leaf.begin(), leaf.end()});
+    }
+
+    return resplit;
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::partial_fit(
+        const std::vector<double> &row, const std::vector<double> &y)
+{
+    this->partial_fit(row, y, 1);
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+bool Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::insert(
+        const std::vector<double> &row, const std::vector<double> &y, size_t weight)
+{
+    const auto n = static_cast<Accumulator>(this->samples_size);
+    const auto w = static_cast<Accumulator>(weight);
+    Accumulator m2 = this->mse * n * static_cast<Accumulator>(y.size());
+
+    for (size_t j = 0; j < y.size(); ++j) {
+        const Accumulator delta = y[j] - this->ymean[j];
+        this->ymean[j] += static_cast<double>(w * delta / (n + w));
+        m2 += w * delta * (y[j] - this->ymean[j]);
+    }
+
+    this->samples_size += weight;
+    this->mse = m2 / (static_cast<Accumulator>(this->samples_size) * static_cast<Accumulator>(y.size()));
+
+    if (this->left && this->right) {
+        auto &next = row[this->best_feature] <= this->best_value ? this->left : this->right;
+        return next->insert(row, y, weight);
+    }
+
+    if (this->depth >= this->max_depth) {
+        return false;
+    }
+
+    this->pending_x.insert(this->pending_x.end(), weight, row);
+    this->pending_y.insert(this->pending_y.end(), weight, y);
+
+    return this->pending_y.size() >= this->min_samples_split && this->grow_pending();
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+bool Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::grow_pending() {
+    std::vector<std::vector<double>> rows_x, y;
+    rows_x.swap(this->pending_x);
+    y.swap(this->pending_y);
+
+    Table x;
+    x.set_column_count(rows_x.front().size());
+    for (const auto &row : rows_x) {
+        x.push_back_row(row);
+    }
+
+    std::vector<int> rows(y.size());
+    std::iota(rows.begin(), rows.end(), 0);
+
+    // The node keeps the statistics of all its observations, not only of the kept ones
+    const std::vector<double> ymean(this->ymean.begin(), this->ymean.end());
+    const Accumulator mse = this->mse;
+    const size_t samples_size = this->samples_size;
+
+    const Matrix observations(y);
+
+    if (single_output(ymean.size())) {
+        this->grow<1>(x, observations, rows, 0, rows.size());
+    }
+    else {
+        this->grow<N_OUT>(x, observations, rows, 0, rows.size());
+    }
+
+    this->ymean.assign(ymean.begin(), ymean.end());
+    this->mse = mse;
+    this->samples_size = samples_size;
+
+    if (!this->left || !this->right) {
+        // Without a split only the latest observations are kept, so retrying stays bounded by min_samples_split
+        this->reset_split();
+        rows_x.erase(rows_x.begin());
+        y.erase(y.begin());
+        this->pending_x.swap(rows_x);
+        this->pending_y.swap(y);
+
+        return false;
+    }
+
+    for (size_t i = 0; i < y.size(); ++i) {
+        Tree_engine *leaf = this->get_leaf(rows_x[i]);
+
+        if (leaf->depth < leaf->max_depth) {
+            leaf->pending_x.push_back(rows_x[i]);
+            leaf->pending_y.push_back(y[i]);
+        }
+    }
+
+    return true;
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::fit(const Table &x, const Matrix &y) {
+    std::vector<int> rows(y.get_rows_count());
+    std::iota(rows.begin(), rows.end(), 0);
+    this->fit_rows(x, y, rows);
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::fit(
+        const Table &x, const Matrix &y, const std::vector<size_t> &weights)
+{
+    if (weights.size() != y.get_rows_count()) {
+        throw std::invalid_argument("Wrong number of weights");
+    }
+
+    std::vector<int> rows = get_weighted_rows(weights);
+    this->fit_rows(x, y, rows);
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::fit(
+        const Binned_features &x, const Matrix &y)
+{
+    std::vector<int> rows(y.get_rows_count());
+    std::iota(rows.begin(), rows.end(), 0);
+    this->fit_rows(x, y, rows);
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::fit(
+        const Binned_features &x, const Matrix &y, const std::vector<size_t> &weights)
+{
+    if (weights.size() != y.get_rows_count()) {
+        throw std::invalid_argument("Wrong number of weights");
+    }
+
+    std::vector<int> rows = get_weighted_rows(weights);
+    this->fit_rows(x, y, rows);
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::fit_rows(
+        const Table &x, const Matrix &y, std::vector<int> &rows)
+{
+    if (rows.empty()) {
+        throw std::invalid_argument("No rows to fit");
+    }
+
+    check_outputs(y.get_columns_count());
+    this->sampling.restart();
+    this->reset_arena();
+    const bool single = single_output(y.get_columns_count());
+
+    if (this->split_method == Split_method::presorted) {
+        Presorted_features features;
+        features.build(x, rows);
+        std::vector<char> goes_right(y.get_rows_count(), 0);
+
+        Growth::run([&]() {
+            if (single) {
+                this->grow<1>(x, y, features, goes_right, 0, rows.size());
+            }
+            else {
+                this->grow<N_OUT>(x, y, features, goes_right, 0, rows.size());
+            }
+        });
+    }
+    else if (this->split_method == Split_method::histogram) {
+        Binned_features bins;
+        bins.build(x);
+        this->fit_rows(bins, y, rows);
+        return;
+    }
+    else {
+        Growth::run([&]() {
+            if (single) {
+                this->grow<1>(x, y, rows, 0, rows.size());
+            }
+            else {
+                this->grow<N_OUT>(x, y, rows, 0, rows.size());
+            }
+        });
+    }
+
+    this->compiled.reset(new Compiled_forest(this->compile()));
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::fit_rows(
+        const Binned_features &x, const Matrix &y, std::vector<int> &rows)
+{
+    if (x.get_rows_count() != y.get_rows_count()) {
+        throw std::invalid_argument("Wrong number of rows");
+    }
+
+    if (rows.empty()) {
+        throw std::invalid_argument("No rows to fit");
+    }
+
+    check_outputs(y.get_columns_count());
+    this->sampling.restart();
+    this->reset_arena();
+    const bool single = single_output(y.get_columns_count());
+
+    if (this->growth_order == Growth_order::level_wise) {
+        Growth::run([&]() {
+            if (single) {
+                this->grow_levels<1>(x, y, rows);
+            }
+            else {
+                this->grow_levels<N_OUT>(x, y, rows);
+            }
+        });
+
+        this->compiled.reset(new Compiled_forest(this->compile()));
+        return;
+    }
+
+    Histogram hist(x, y.get_columns_count());
+    hist.build(x, y, rows.data(), rows.size());
+
+    Growth::run([&]() {
+        if (single) {
+            this->grow<1>(x, y, rows, hist, 0, rows.size());
+        }
+        else {
+            this->grow<N_OUT>(x, y, rows, hist, 0, rows.size());
+        }
+    });
+
+    this->compiled.reset(new Compiled_forest(this->compile()));
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+template <size_t Outputs>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::grow(
+        const Table &x, const Matrix &y, std::vector<int> &rows, size_t begin, size_t end)
+{
+    const size_t count = end - begin;
+    this->set_statistics<Outputs>(y, rows.data() + begin, count);
+    this->reset_split();
+
+    if (this->depth < this->max_depth && count >= this->min_samples_split) {
+        auto best_split_values = this->get_best_split<Outputs>(x, y, rows, begin, end);
+
+        if (best_split_values.first != -1) {
+            this->best_feature = best_split_values.first;
+            this->best_value = best_split_values.second;
+
+            const size_t mid = this->split(x, rows, begin, end);
+
+            if (mid != begin) {
+                this->left = this->create_child(1);
+                Growth::spawn([this, &x, &y, &rows, begin, mid]() {
+                    this->left->grow<Outputs>(x, y, rows, begin, mid);
+                });
+            }
+
+            if (mid != end) {
+                this->right = this->create_child(2);
+                this->right->grow<Outputs>(x, y, rows, mid, end);
+            }
+            Growth::wait();
+        }
+    }
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+template <size_t Outputs>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::grow(
+        const Binned_features &bins, const Matrix &y, std::vector<int> &rows, Histogram &hist, size_t begin,
+        size_t end)
+{
+    const int *node_rows = rows.data() + begin;
+    const size_t count = end - begin;
+    this->set_statistics<Outputs>(y, node_rows, count);
+    this->reset_split();
+
+    if (this->depth < this->max_depth && count >= this->min_samples_split) {
+        auto best_split_values = this->get_best_split(hist, get_target_sums<Outputs>(y, node_rows, count), count);
+
+        if (best_split_values.first != -1) {
+            this->best_feature = best_split_values.first;
+            this->best_value = bins.get_bound(best_split_values.first, best_split_values.second);
+
+            const uint8_t *codes = bins.codes(this->best_feature);
+            const auto bin = static_cast<uint8_t>(best_split_values.second);
+            Phase_timer partition(Phase::partition);
+            const size_t mid = std::partition(rows.begin() + begin, rows.begin() + end,
+                                              [codes, bin](int row){return codes[row] <= bin;}) - rows.begin();
+            partition.stop();
+
+            // Only the smaller child histogram is built, the larger one is derived from the parent histogram
+            const bool left_grows = this->depth + 1 < this->max_depth && mid - begin >= this->min_samples_split;
+            const bool right_grows = this->depth + 1 < this->max_depth && end - mid >= this->min_samples_split;
+            const bool left_smaller = mid - begin <= end - mid;
+            Histogram smaller;
+
+            if (left_grows || right_grows) {
+                smaller = Histogram(bins, this->ymean.size());
+                smaller.build(bins, y, rows.data() + (left_smaller ? begin : mid),
+                              left_smaller ? mid - begin : end - mid);
+
+                if (left_smaller ? right_grows : left_grows) {
+                    hist.subtract(smaller);
+                }
+            }
+
+            Histogram *left_hist = left_smaller ? &smaller : &hist;
+            Histogram *right_hist = left_smaller ? &hist : &smaller;
+
+            if (mid != begin) {
+                this->left = this->create_child(1);
+                Growth::spawn([this, &bins, &y, &rows, left_hist, begin, mid]() {
+                    this->left->grow<Outputs>(bins, y, rows, *left_hist, begin, mid);
+                });
+            }
+
+            if (mid != end) {
+                this->right = this->create_child(2);
+                this->right->grow<Outputs>(bins, y, rows, *right_hist, mid, end);
+            }
+            Growth::wait();
+        }
+    }
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+template <size_t Outputs>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::grow_levels(
+        const Binned_features &bins, const Matrix &y, const std::vector<int> &rows)
+{
+    const size_t outputs = Outputs ? Outputs : y.get_columns_count();
+    const double *data = y.data();
+    const bool parallel = Growth::threads() > 1;
+
+    std::vector<Tree_engine*> level(1, this); // Nodes of the current depth
+    std::vector<int> live(rows);              // Rows of the nodes of the current depth
+    std::vector<int> nodes(rows.size(), 0);   // Level node of every live row
+    std::vector<Histogram> parent_hists;      // Histograms of the previous level nodes
+    std::vector<int> first_child;             // Level index of the left child of every previous level node (-1 - leaf)
+    std::vector<const uint8_t*> split_codes;  // Bin codes of the split feature of every previous level node
+    std::vector<uint8_t> split_bins;          // Last bin going left of every previous level node
+
+    while (!level.empty()) {
+        const size_t n_nodes = level.size();
+        std::vector<size_t> counts(n_nodes, 0);
+        std::vector<long double> sums(n_nodes * outputs, 0), sums2(n_nodes * outputs, 0);
+
+        // Rows are routed to the children of the split nodes and summed in one pass, rows of leaves are dropped
+        Phase_timer statistics(Phase::node_statistics);
+        size_t n_live = 0;
+        for (size_t i = 0; i < live.size(); ++i) {
+            int node = nodes[i];
+
+            if (!first_child.empty()) {
+                if (first_child[node] < 0) {
+                    continue;
+                }
+                node = first_child[node] + (split_codes[node][live[i]] > split_bins[node]);
+            }
+
+            live[n_live] = live[i];
+            nodes[n_live++] = node;
+
+            const double *row = data + live[i] * outputs;
+            long double *sum = sums.data() + node * outputs;
+            long double *sum2 = sums2.data() + node * outputs;
+
+            ++counts[node];
+            for (size_t j = 0; j < outputs; ++j) {
+                sum[j] += row[j];
+                sum2[j] += static_cast<long double>(row[j]) * row[j];
+            }
+        }
+
+        live.resize(n_live);
+        nodes.resize(n_live);
+
+        // The node error is taken from the same sums as the split errors of the histogram scan
+        std::vector<char> grows(n_nodes, 0);
+        for (size_t k = 0; k < n_nodes; ++k) {
+            Tree_engine *node = level[k];
+            const auto count = static_cast<long double>(counts[k]);
+            long double mse = 0;
+
+            node->ymean.resize(outputs);
+            for (size_t j = 0; j < outputs; ++j) {
+                node->ymean[j] = static_cast<double>(sums[k * outputs + j] / count);
+                mse += sums2[k * outputs + j] - sums[k * outputs + j] * sums[k * outputs + j] / count;
+            }
+
+            node->mse = static_cast<Accumulator>(mse / (count * static_cast<long double>(outputs)));
+            node->samples_size = counts[k];
+            node->reset_split();
+            grows[k] = node->depth < this->max_depth && counts[k] >= this->min_samples_split;
+        }
+        statistics.stop();
+
+        // Only the smaller child of a split is accumulated, the larger one takes over the parent histogram
+        std::vector<Histogram> hists(n_nodes);
+        std::vector<Histogram*> built(n_nodes, nullptr);
+
+        if (first_child.empty()) {
+            if (grows[0]) {
+                hists[0] = Histogram(bins, outputs);
+                built[0] = &hists[0];
+            }
+        }
+        else {
+            for (size_t p = 0; p < first_child.size(); ++p) {
+                if (first_child[p] < 0) {
+                    continue;
+                }
+
+                const auto left = static_cast<size_t>(first_child[p]);
+                const size_t smaller = counts[left] <= counts[left + 1] ? left : left + 1;
+                const size_t larger = 2 * left + 1 - smaller;
+
+                if (grows[smaller] || grows[larger]) {
+                    hists[smaller] = Histogram(bins, outputs);
+                    built[smaller] = &hists[smaller];
+                }
+
+                if (grows[larger]) {
+                    hists[larger] = std::move(parent_hists[p]);
+                }
+            }
+        }
+
+        std::vector<int> hist_rows, hist_nodes;
+        for (size_t i = 0; i < live.size(); ++i) {
+            if (built[nodes[i]]) {
+                hist_rows.push_back(live[i]);
+                hist_nodes.push_back(nodes[i]);
+            }
+        }
+
+        if (!hist_rows.empty()) {
+            for_each_index(bins.get_features_count(), parallel && hist_rows.size() >= parallel_split_rows,
+                           [&](size_t feature) {
+                Histogram::build_level(built, feature, bins, y, hist_rows.data(), hist_nodes.data(), hist_rows.size());
+            });
+        }
+
+        for (size_t p = 0; p < first_child.size(); ++p) {
+            if (first_child[p] < 0) {
+                continue;
+            }
+
+            const auto left = static_cast<size_t>(first_child[p]);
+            const size_t smaller = counts[left] <= counts[left + 1] ? left : left + 1;
+            const size_t larger = 2 * left + 1 - smaller;
+
+            if (grows[larger]) {
+                hists[larger].subtract(hists[smaller]);
+            }
+        }
+
+        std::vector<std::pair<int, int>> splits(n_nodes, std::pair<int, int>(-1, 0));
+        for_each_index(n_nodes, parallel && live.size() >= parallel_split_rows, [&](size_t k) {
+            if (!grows[k]) {
+                return;
+            }
+
+            Tree_engine *node = level[k];
+            Target_sums node_sums;
+            node_sums.n = static_cast<long double>(counts[k] * outputs);
+            node_sums.sum.assign(sums.begin() + k * outputs, sums.begin() + (k + 1) * outputs);
+            node_sums.sum2.assign(sums2.begin() + k * outputs, sums2.begin() + (k + 1) * outputs);
+            for (size_t j = 0; j < outputs; ++j) {
+                node_sums.sum[j] /= node_sums.n;
+                node_sums.sum2[j] /= node_sums.n;
+            }
+
+            splits[k] = node->get_best_split(hists[k], node_sums, counts[k]);
+
+            if (splits[k].first != -1) {
+                node->best_feature = splits[k].first;
+                node->best_value = bins.get_bound(splits[k].first, splits[k].second);
+                node->left = node->create_child(1);
+                node->right = node->create_child(2);
+            }
+        });
+
+        std::vector<Tree_engine*> next;
+        first_child.assign(n_nodes, -1);
+        split_codes.assign(n_nodes, nullptr);
+        split_bins.assign(n_nodes, 0);
+
+        for (size_t k = 0; k < n_nodes; ++k) {
+            if (splits[k].first == -1) {
+                hists[k] = Histogram();
+                continue;
+            }
+
+            first_child[k] = static_cast<int>(next.size());
+            split_codes[k] = bins.codes(splits[k].first);
+            split_bins[k] = static_cast<uint8_t>(splits[k].second);
+            next.push_back(level[k]->left);
+            next.push_back(level[k]->right);
+        }
+
+        parent_hists.swap(hists);
+        level.swap(next);
+    }
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+template <size_t Outputs>
+void Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::grow(
+        const Table &x, const Matrix &y, Presorted_features &features, std::vector<char> &goes_right, size_t begin,
+        size_t end)
+{
+    const int *rows = features.order(0, begin);
+    const size_t count = end - begin;
+    this->set_statistics<Outputs>(y, rows, count);
+    this->reset_split();
+
+    if (this->depth < this->max_depth && count >= this->min_samples_split) {
+        auto best_split_values = this->get_best_split<Outputs>(x, y, features, begin, end);
+
+        if (best_split_values.first != -1) {
+            this->best_feature = best_split_values.first;
+            this->best_value = best_split_values.second;
+
+            Phase_timer flags(Phase::partition);
+            const Array_view arr = x.column(this->best_feature);
+            for (size_t i = 0; i < count; ++i) {
+                goes_right[rows[i]] = arr[rows[i]] > this->best_value;
+            }
+            flags.stop();
+
+            const size_t mid = features.partition(begin, end, goes_right);
+
+            if (mid != begin) {
+                this->left = this->create_child(1);
+                Growth::spawn([this, &x, &y, &features, &goes_right, begin, mid]() {
+                    this->left->grow<Outputs>(x, y, features, goes_right, begin, mid);
+                });
+            }
+
+            if (mid != end) {
+                this->right = this->create_child(2);
+                this->right->grow<Outputs>(x, y, features, goes_right, mid, end);
+            }
+            Growth::wait();
+        }
+    }
+}
+
+template <typename Sampling, typename Growth, typename Thresholds, typename Criterion, typename Accumulator,
+          size_t N_OUT>
+Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>*
+Tree_engine<Sampling, Growth, Thresholds, Criterion, Accumulator, N_OUT>::get_leaf(const std::vector<double> &row) {
+    Tree_engine *node = this;
+
+    while (node->left && node->right) {
+        node = (row[node->best_feature] <= node->best_value ? node->left : node->right);
+    }
+
+    return node;
+}
+
+
+#endif //TREE_TREE_ENGINE_H
@@ -3,10 +3,13 @@
 #include "Random_forest_tree.h"
 #include "Random_forest_regressor.h"
 #include "Tools.h"
+#include "Profiler.h"
 
 int main() {
     constexpr int n_in = 7, n_out = 1;
 
+    Profiler::set_enabled(true);
+
     Table t;
 //    t.load_from_file("../dataset.csv", {"Day"});
 //    t.load_from_file("../daily-total-female-births.csv", {"Date"});